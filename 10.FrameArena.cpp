@@ -0,0 +1,68 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    Task<int>  Produce (int value)
+    {
+        co_return value * 2;
+    }
+
+    Task<int>  Combine (Task<int> a, Task<int> b)
+    {
+        auto [x, y] = co_await std::tuple{ a, b };
+        co_return x + y;
+    }
+
+
+    void  Run ()
+    {
+        auto&       ts = TaskSystem::create( 4 );
+        FrameArena  arena;
+        int         resets  = 0;
+
+        for (int tick = 0; tick < 3; ++tick)
+        {
+            {
+                // all coroutine frames in this scope are allocated in the arena
+                TaskSystem::FrameArenaScope     scope {ts, arena};
+
+                std::vector< Task<int> >    tasks;
+                for (int i = 0; i < 16; ++i)
+                {
+                    auto    a = Produce( i );
+                    auto    b = Produce( i+1 );
+                    auto    c = Combine( a, b );
+
+                    ts.add( c );
+                    ts.add( b );
+                    ts.add( a );
+
+                    tasks.push_back( c );
+                }
+
+                int     sum = 0;
+                for (auto& t : tasks)
+                {
+                    for (; not t.is_complete();) {
+                        std::this_thread::yield();
+                    }
+                    sum += t.get_result();
+                }
+                std::cout << std::dec << "tick " << tick << ", sum: " << sum << ", arena used: " << arena.used_bytes() << " bytes\n";
+            }
+
+            // reuse memory in the next tick, if some task is still referenced by a worker, the arena grows until the next reset
+            resets += int(arena.reset());
+        }
+        std::cout << "arena reset: " << resets << " of 3 ticks\n";
+
+        ts.wait();
+        TaskSystem::destroy();
+    }
+}
+
+extern void  FrameArenaSample ()
+{
+    std::cout << "\n---- 10.FrameArena ----\n";
+    Run();
+}
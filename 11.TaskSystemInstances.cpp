@@ -0,0 +1,56 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::mutex   consoleGuard;
+
+    Task<int>  BatchJob (int index, TaskSystem &latency)
+    {
+        {
+            std::scoped_lock  lock {consoleGuard};
+            std::cout << "BatchJob " << std::dec << index << ", tid:" << std::hex << TID() << "\n";
+        }
+
+        // latency-critical part is executed in the dedicated task system
+        co_await schedule_on( latency );
+        {
+            std::scoped_lock  lock {consoleGuard};
+            std::cout << "BatchJob " << std::dec << index << ", latency part, tid:" << std::hex << TID() << "\n";
+        }
+        co_return index;
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  latency {1};
+        TaskSystem  batch   {2};
+
+        std::vector< Task<int> >    tasks;
+        for (int i = 0; i < 4; ++i)
+        {
+            tasks.push_back( BatchJob( i, latency ));
+            batch.add( tasks.back() );
+        }
+
+        for (auto& t : tasks)
+        {
+            for (; not t.is_complete();) {
+                std::this_thread::yield();
+            }
+        }
+
+        auto    ls = latency.stats();
+        auto    bs = batch.stats();
+        std::cout << std::dec << "latency: { added: " << ls.added << ", completed: " << ls.completed << " }\n"
+                  << "batch: { added: " << bs.added << ", completed: " << bs.completed << " }\n";
+
+        // destructors stop worker threads
+    }
+}
+
+extern void  TaskSystemInstances ()
+{
+    std::cout << "\n---- 11.TaskSystemInstances ----\n";
+    Run();
+}
@@ -0,0 +1,72 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::atomic<int>     counter {0};
+
+    Task<>  Leaf ()
+    {
+        counter.fetch_add( 1 );
+        co_return;
+    }
+
+    using Clock_t = std::chrono::high_resolution_clock;
+
+    [[nodiscard]] double  ToMs (Clock_t::duration d)
+    {
+        return std::chrono::duration_cast< std::chrono::duration<double, std::milli> >( d ).count();
+    }
+
+
+    void  Run ()
+    {
+        const int   count = 50'000;
+        TaskSystem  ts {4};
+
+        // add tasks one by one
+        {
+            std::vector< Task<> >   tasks;
+            for (int i = 0; i < count; ++i) {
+                tasks.push_back( Leaf() );
+            }
+
+            counter.store( 0 );
+            auto    start = Clock_t::now();
+
+            for (auto& t : tasks) {
+                ts.add( t );
+            }
+            auto    added = Clock_t::now();
+
+            for (; counter.load() != count;) {
+                std::this_thread::yield();
+            }
+            std::cout << "single add: " << ToMs( added - start ) << " ms, complete: " << ToMs( Clock_t::now() - start ) << " ms\n";
+        }
+
+        // add tasks in a single batch
+        {
+            std::vector< Task<> >   tasks;
+            for (int i = 0; i < count; ++i) {
+                tasks.push_back( Leaf() );
+            }
+
+            counter.store( 0 );
+            auto    start = Clock_t::now();
+
+            ts.add( tasks );
+            auto    added = Clock_t::now();
+
+            for (; counter.load() != count;) {
+                std::this_thread::yield();
+            }
+            std::cout << "batch add:  " << ToMs( added - start ) << " ms, complete: " << ToMs( Clock_t::now() - start ) << " ms\n";
+        }
+    }
+}
+
+extern void  BulkSubmission ()
+{
+    std::cout << "\n---- 12.BulkSubmission ----\n";
+    Run();
+}
@@ -0,0 +1,54 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::mutex   consoleGuard;
+
+    Task<>  Coro (size_t mainTid)
+    {
+        {
+            std::scoped_lock  lock {consoleGuard};
+            std::cout << "Coro, worker: " << std::dec << TaskSystem::worker_index() << "\n";
+        }
+
+        // window and graphics API calls must be in the main thread
+        co_await switch_to( ThreadAffinity::Main );
+        {
+            std::scoped_lock  lock {consoleGuard};
+            std::cout << "Coro, main thread: " << (TID() == mainTid ? "yes" : "no") << "\n";
+        }
+
+        co_await switch_to( WorkerIndex{1} );
+        {
+            std::scoped_lock  lock {consoleGuard};
+            std::cout << "Coro, worker: " << std::dec << TaskSystem::worker_index() << "\n";
+        }
+
+        co_await switch_to( ThreadAffinity::Any );
+        co_return;
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts  {2};
+        auto        t0  = Coro( TID() );
+
+        ts.add( t0 );
+
+        // frame loop
+        for (; not t0.is_complete();)
+        {
+            // limit time which is spent for main thread tasks
+            ts.process_main_thread( std::chrono::milliseconds{2} );
+
+            std::this_thread::sleep_for( std::chrono::milliseconds{1} );
+        }
+    }
+}
+
+extern void  ThreadAffinitySample ()
+{
+    std::cout << "\n---- 13.ThreadAffinity ----\n";
+    Run();
+}
@@ -0,0 +1,69 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    using Clock_t = std::chrono::steady_clock;
+
+    [[nodiscard]] double  ToMs (Clock_t::duration d)
+    {
+        return std::chrono::duration_cast< std::chrono::duration<double, std::milli> >( d ).count();
+    }
+
+
+    Task<>  LongCrunch (bool cooperative)
+    {
+        const auto  end = Clock_t::now() + std::chrono::milliseconds{50};
+
+        for (; Clock_t::now() < end;)
+        {
+            // simulate work
+            std::this_thread::sleep_for( std::chrono::microseconds{100} );
+
+            // suspend if time slice is over or high priority task is waiting
+            if ( cooperative )
+                co_await maybe_yield();
+        }
+        co_return;
+    }
+
+    Task<>  Urgent (Clock_t::time_point &completed)
+    {
+        completed = Clock_t::now();
+        co_return;
+    }
+
+
+    void  Measure (bool cooperative)
+    {
+        TaskSystem  ts {1};
+        ts.set_time_slice( std::chrono::microseconds{500} );
+
+        Clock_t::time_point     completed;
+        auto    t0  = LongCrunch( cooperative );
+        auto    t1  = Urgent( completed );
+
+        ts.add( t0 );
+        std::this_thread::sleep_for( std::chrono::milliseconds{5} );
+
+        auto    start = Clock_t::now();
+        ts.add( t1, TaskPriority::High );
+
+        for (; not t0.is_complete() or not t1.is_complete();) {
+            std::this_thread::yield();
+        }
+        std::cout << (cooperative ? "with maybe_yield:    " : "without maybe_yield: ") << "urgent task latency " << ToMs( completed - start ) << " ms\n";
+    }
+
+
+    void  Run ()
+    {
+        Measure( false );
+        Measure( true );
+    }
+}
+
+extern void  CooperativeYield ()
+{
+    std::cout << "\n---- 14.CooperativeYield ----\n";
+    Run();
+}
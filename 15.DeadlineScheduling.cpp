@@ -0,0 +1,61 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::mutex   consoleGuard;
+
+    Task<>  Blocker ()
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds{10} );
+        co_return;
+    }
+
+    Task<>  Job (int deadlineMs)
+    {
+        {
+            std::scoped_lock  lock {consoleGuard};
+            std::cout << "Job with deadline " << std::dec << deadlineMs << " ms\n";
+        }
+        co_return;
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts {1};
+
+        ts.set_deadline_miss_handler( [] (AsyncTask &, std::chrono::nanoseconds lateness)
+            {
+                std::scoped_lock  lock {consoleGuard};
+                std::cout << "deadline missed by " << std::dec << std::chrono::duration_cast<std::chrono::milliseconds>( lateness ).count() << " ms\n";
+            });
+
+        // worker is busy while tasks are added
+        auto    blocker = Blocker();
+        ts.add( blocker );
+        std::this_thread::sleep_for( std::chrono::milliseconds{1} );
+
+        const auto              now = std::chrono::steady_clock::now();
+        std::vector< Task<> >   tasks;
+
+        for (int ms : {40, 20, 50, 30, 1})
+        {
+            tasks.push_back( Job( ms ));
+            ts.add( tasks.back(), now + std::chrono::milliseconds{ms} );
+        }
+
+        for (auto& t : tasks)
+        {
+            for (; not t.is_complete();) {
+                std::this_thread::yield();
+            }
+        }
+        std::cout << "missed: " << std::dec << ts.stats().deadlineMissed << "\n";
+    }
+}
+
+extern void  DeadlineScheduling ()
+{
+    std::cout << "\n---- 15.DeadlineScheduling ----\n";
+    Run();
+}
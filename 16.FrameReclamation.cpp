@@ -0,0 +1,70 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    Task<int>  Producer (int index)
+    {
+        // large local variable is stored in coroutine frame because it is used after suspension
+        std::array< int, 1024 >     data;
+        data.fill( index );
+
+        co_await yield_now();
+
+        int     sum = 0;
+        for (int v : data) {
+            sum += v;
+        }
+        co_return sum;
+    }
+
+    // Wide fan-in: consumer keeps handles to all producers to read results at the end.
+    Task<int64_t>  Consumer (int waveCount, int waveSize)
+    {
+        std::vector< Task<int> >    inputs;
+
+        for (int w = 0; w < waveCount; ++w)
+        {
+            for (int i = 0; i < waveSize; ++i)
+            {
+                inputs.push_back( Producer( w * waveSize + i ));
+                TaskSystem::current()->add( inputs.back() );
+            }
+
+            for (size_t i = inputs.size() - waveSize; i < inputs.size(); ++i) {
+                co_await inputs[i];
+            }
+        }
+
+        // only small shared states are alive, producer frames are already destroyed
+        int64_t     sum = 0;
+        for (auto& t : inputs) {
+            sum += t.get_result();
+        }
+        co_return sum;
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts {4};
+        reset_task_memory_peak();
+
+        auto    t0 = Consumer( 32, 64 );
+        ts.add( t0 );
+
+        for (; not t0.is_complete();) {
+            std::this_thread::yield();
+        }
+
+        auto    mem = task_memory_stats();
+        std::cout << std::dec << "result: " << t0.get_result() << "\n"
+                  << "allocated for tasks: " << (mem.totalBytes >> 10) << " Kb\n"
+                  << "peak task memory:    " << (mem.peakBytes >> 10) << " Kb\n";
+    }
+}
+
+extern void  FrameReclamation ()
+{
+    std::cout << "\n---- 16.FrameReclamation ----\n";
+    Run();
+}
@@ -0,0 +1,43 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::atomic<int>     counter {0};
+
+    Task<int>  Fib (int n)
+    {
+        counter.fetch_add( 1 );
+
+        if ( n < 2 )
+            co_return n;
+
+        // dependencies are not added to the task system,
+        // they are scheduled in the worker queue when they are awaited
+        auto    [a, b] = co_await std::tuple{ Fib( n-1 ), Fib( n-2 )};
+        co_return a + b;
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts {4};
+
+        // only the root task is added
+        auto    t0 = Fib( 16 );
+        ts.add( t0 );
+
+        for (; not t0.is_complete();) {
+            std::this_thread::yield();
+        }
+
+        auto    stat = ts.stats();
+        std::cout << std::dec << "fib(16): " << t0.get_result() << ", tasks: " << counter.load() << "\n"
+                  << "executed: " << stat.executed << ", completed: " << stat.completed << "\n";
+    }
+}
+
+extern void  AutoScheduling ()
+{
+    std::cout << "\n---- 17.AutoScheduling ----\n";
+    Run();
+}
@@ -0,0 +1,85 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::mutex   consoleGuard;
+
+    // Emulation of callback-based API, callback is called from another thread.
+    void  LoadFileAsync (std::string name, std::function< void (std::string) > onLoaded, std::function< void () > onError)
+    {
+        std::thread{ [name = std::move(name), onLoaded = std::move(onLoaded), onError = std::move(onError)] ()
+            {
+                std::this_thread::sleep_for( std::chrono::milliseconds{10} );
+
+                if ( name.empty() )
+                    onError();
+                else
+                    onLoaded( "content of " + name );
+            }}.detach();
+    }
+
+    // Wrap callback into task, worker is not blocked while file is loading.
+    Task<std::string>  LoadFile (std::string name)
+    {
+        TaskCompletionSource<std::string>   tcs;
+
+        LoadFileAsync( std::move(name),
+                       [tcs] (std::string data) mutable { tcs.set_value( std::move(data) ); },
+                       [tcs] () mutable { tcs.set_exception( std::make_exception_ptr( std::runtime_error{"file not found"} )); });
+
+        return tcs.get_task();
+    }
+
+
+    Task<>  Reader (int index, Task<std::string> file)
+    {
+        std::string     data = co_await file;
+
+        std::scoped_lock  lock {consoleGuard};
+        std::cout << "Reader " << std::dec << index << ": " << data << "\n";
+    }
+
+    Task<>  ErrorHandler (Task<std::string> file)
+    {
+        try {
+            (void)(co_await file);
+        }
+        catch (const std::exception &e)
+        {
+            std::scoped_lock  lock {consoleGuard};
+            std::cout << "ErrorHandler: " << e.what() << "\n";
+        }
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts {2};
+
+        // single result is shared between all readers
+        auto                    file = LoadFile( "config.txt" );
+        std::vector< Task<> >   tasks;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            tasks.push_back( Reader( i, file ));
+            ts.add( tasks.back() );
+        }
+
+        tasks.push_back( ErrorHandler( LoadFile( "" )));
+        ts.add( tasks.back() );
+
+        for (auto& t : tasks)
+        {
+            for (; not t.is_complete();) {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+extern void  CompletionSource ()
+{
+    std::cout << "\n---- 18.CompletionSource ----\n";
+    Run();
+}
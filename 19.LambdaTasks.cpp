@@ -0,0 +1,118 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::atomic<int>     counter {0};
+
+    Task<>  CoroLeaf ()
+    {
+        counter.fetch_add( 1 );
+        co_return;
+    }
+
+    using Clock_t = std::chrono::high_resolution_clock;
+
+
+    Task<int>  Sum ()
+    {
+        // lambda tasks are scheduled when they are awaited
+        auto    a = make_task( [] () { return 1; });
+        auto    b = make_task( [] () { return 2; });
+
+        // executed when 'a' and 'b' are complete
+        auto    c = make_task( [a, b] () { return a.get_result() + b.get_result(); }, a, b );
+
+        co_return co_await c;
+    }
+
+
+    // Returns time per task in nanoseconds and memory per task.
+    // Tasks are created and released in small batches, so memory is reused like in a real workload.
+    // If 'ts' is null then tasks are not executed.
+    template <typename Fn>
+    [[nodiscard]] std::pair< double, size_t >  Measure (TaskSystem* ts, Fn &&fn)
+    {
+        const int               batch   = 1'000;
+        const int               count   = 100;
+        std::vector< Task<> >   tasks;
+        tasks.reserve( batch );
+
+        counter.store( 0 );
+        auto    mem0    = task_memory_stats();
+        auto    start   = Clock_t::now();
+
+        for (int j = 0; j < count; ++j)
+        {
+            for (int i = 0; i < batch; ++i) {
+                tasks.push_back( fn() );
+            }
+
+            if ( ts != nullptr )
+            {
+                ts->add( tasks );
+                for (auto& t : tasks) {
+                    ts->run_until( t );
+                }
+            }
+            tasks.clear();
+        }
+
+        auto    mem1 = task_memory_stats();
+        return { std::chrono::duration<double, std::nano>( Clock_t::now() - start ).count() / (batch * count),
+                 (mem1.totalBytes - mem0.totalBytes) / (batch * count) };
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts {4};
+
+        auto    t0 = Sum();
+        ts.add( t0 );
+
+        for (; not t0.is_complete();) {
+            std::this_thread::yield();
+        }
+        std::cout << "sum: " << std::dec << t0.get_result() << "\n";
+
+        // add lambda directly to the task system
+        auto    t1 = ts.add( [] () { return TaskSystem::worker_index(); });
+
+        for (; not t1.is_complete();) {
+            std::this_thread::yield();
+        }
+        std::cout << "lambda executed on worker: " << t1.get_result() << "\n";
+
+        const auto  Coro    = [] () { return CoroLeaf(); };
+        const auto  Lambda  = [] () { return make_task( [] () { counter.fetch_add( 1 ); }); };
+
+        // Lambda task has no coroutine frame, its shared state with small captures is a single block from the pool,
+        // so it takes less memory than the shared state and the frame of the smallest coroutine.
+        // Scheduling and execution by the task system are the same for both, so the lambda task
+        // saves only the frame allocation and the resumption, it is cheaper by a fraction, not many times.
+        TaskSystem  inl {0};
+        (void)Measure( &inl, Lambda );   // warm up the pool
+
+        const auto  Print = [&] (const char* name, TaskSystem* target)
+        {
+            auto [coroNs, coroMem]      = Measure( target, Coro );
+            auto [lambdaNs, lambdaMem]  = Measure( target, Lambda );
+
+            // local stream, so the format does not affect other samples
+            std::ostringstream  str;
+            str << std::fixed << std::setprecision( 0 ) << name
+                << "coroutine " << coroNs << " ns (" << coroMem << " bytes), lambda " << lambdaNs << " ns (" << lambdaMem << " bytes), "
+                << std::setprecision( 2 ) << (coroNs / lambdaNs) << "x\n";
+            std::cout << str.str();
+        };
+        Print( "create and release:  ", nullptr );
+        Print( "execute inline:      ", &inl );
+        Print( "execute on workers:  ", &ts );
+    }
+}
+
+extern void  LambdaTasks ()
+{
+    std::cout << "\n---- 19.LambdaTasks ----\n";
+    Run();
+}
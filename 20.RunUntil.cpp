@@ -0,0 +1,48 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    Task<int>  Compute (int value)
+    {
+        co_await yield_now();
+        co_return value * 2;
+    }
+
+    // Legacy synchronous code which is called from a task and needs a result of coroutine.
+    // With single worker thread blocking wait is a deadlock, 'run_until()' executes 'Compute()' in the same thread.
+    int  LegacyCallback (int value)
+    {
+        return TaskSystem::current()->run_until( Compute( value ));
+    }
+
+    // Each level blocks inside the task and keeps its stack alive.
+    // After 'TaskSystem::MaxRunUntilDepth' nested calls the thread executes only tasks which are pinned to it,
+    // so deep recursion must be resolved by other threads.
+    int  Recursive (int depth)
+    {
+        if ( depth == 0 )
+            return 0;
+
+        auto    t = make_task( [depth] () { return Recursive( depth - 1 ) + 1; });
+        return TaskSystem::current()->run_until( t );
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts {1};
+
+        auto    t0 = ts.add( [] () { return LegacyCallback( 21 ); });
+        auto    t1 = ts.add( [] () { return Recursive( 8 ); });
+
+        // main thread helps to execute tasks too
+        std::cout << std::dec << "legacy: " << ts.run_until( t0 ) << "\n"
+                  << "recursive: " << ts.run_until( t1 ) << "\n";
+    }
+}
+
+extern void  RunUntil ()
+{
+    std::cout << "\n---- 20.RunUntil ----\n";
+    Run();
+}
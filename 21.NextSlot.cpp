@@ -0,0 +1,114 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    using Buffer_t  = std::shared_ptr< std::vector<uint32_t> >;
+    using Clock_t   = std::chrono::high_resolution_clock;
+
+    static constexpr size_t     BufferSize  = 64 << 10;     // 256 KB
+    static constexpr int        ChainCount  = 64;
+    static constexpr int        ChainLength = 8;
+    static constexpr int        Runs        = 3;
+
+    [[nodiscard]] double  ToMs (Clock_t::duration d)
+    {
+        return std::chrono::duration_cast< std::chrono::duration<double, std::milli> >( d ).count();
+    }
+
+
+    Task<Buffer_t>  Produce (int seed)
+    {
+        // buffer of one chain fits into L2 cache, buffers of all chains do not
+        auto    buf = std::make_shared< std::vector<uint32_t> >( BufferSize );
+        for (auto& v : *buf) {
+            v = uint32_t(seed++);
+        }
+        co_return buf;
+    }
+
+    // Consumer reads data which is just written by the producer.
+    Task<Buffer_t>  Transform (Task<Buffer_t> prev)
+    {
+        Buffer_t    buf = co_await prev;
+        for (auto& v : *buf) {
+            v = v * 3 + 1;
+        }
+        co_return buf;
+    }
+
+    Task<int64_t>  Chain (int seed, int length)
+    {
+        Task<Buffer_t>  t = Produce( seed );
+        for (int i = 0; i < length; ++i) {
+            t = Transform( t );
+        }
+
+        Buffer_t    buf = co_await t;
+        int64_t     sum = 0;
+        for (uint32_t v : *buf) {
+            sum += v;
+        }
+        co_return sum;
+    }
+
+
+    // Without the slot the continuation is added to the back of the lane, so all chains advance
+    // step by step and each step reads the buffer from memory. With the slot the continuation runs next,
+    // so the chain runs to the end while its buffer is in cache and it is not stolen by another core.
+    [[nodiscard]] double  Measure (bool useNextSlot, size_t &fromSlot, size_t &executed)
+    {
+        TaskSystem  ts {4};
+        ts.set_next_slot( useNextSlot );
+
+        std::vector< Task<int64_t> >    chains;
+        for (int i = 0; i < ChainCount; ++i) {
+            chains.push_back( Chain( i, ChainLength ));
+        }
+
+        auto    start = Clock_t::now();
+        ts.add( chains );
+
+        for (auto& c : chains) {
+            ts.run_until( c );
+        }
+
+        const double    ms      = ToMs( Clock_t::now() - start );
+        auto            stat    = ts.stats();
+        fromSlot    = stat.nextSlot;
+        executed    = stat.executed;
+        return ms;
+    }
+
+
+    void  Run ()
+    {
+        size_t  fromSlot    = 0;
+        size_t  executed    = 0;
+
+        // first run pays for page faults and heap growth, it is not measured
+        (void)Measure( true, fromSlot, executed );
+
+        // modes are measured alternately and the best run is used, so noise of other processes affects both
+        double  without = std::numeric_limits<double>::max();
+        double  with    = std::numeric_limits<double>::max();
+        for (int i = 0; i < Runs; ++i)
+        {
+            without = std::min( without, Measure( false, fromSlot, executed ));
+            with    = std::min( with,    Measure( true,  fromSlot, executed ));
+        }
+
+        std::ostringstream  str;
+        str << std::fixed << std::setprecision( 2 )
+            << "best of " << Runs << " runs, " << ChainCount << " chains of " << ChainLength << " steps\n"
+            << "without LIFO slot: " << without << " ms\n"
+            << "with LIFO slot:    " << with << " ms, from slot: " << fromSlot << " of " << executed << "\n"
+            << "LIFO slot speedup: " << (without / with) << "x\n";
+        std::cout << str.str();
+    }
+}
+
+extern void  NextSlot ()
+{
+    std::cout << "\n---- 21.NextSlot ----\n";
+    Run();
+}
@@ -0,0 +1,68 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    // Per-entity state, protected by strand instead of mutex.
+    struct Account
+    {
+        Strand              strand;
+        int64_t             balance     = 0;
+        std::vector<int>    history;
+
+        explicit Account (TaskSystem &ts) : strand{ts} {}
+    };
+
+
+    Task<int>  Compute (int value)
+    {
+        co_return value;
+    }
+
+    Task<>  Deposit (Account &acc, int value)
+    {
+        // executed in any worker without synchronization
+        int     amount = co_await Compute( value );
+
+        // executed in the strand, one at a time
+        co_await acc.strand.schedule();
+        acc.balance += amount;
+
+        // coroutine is still in the strand after resuming
+        co_await yield_now();
+        acc.balance -= amount / 2;
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts  {4};
+        Account     acc {ts};
+
+        // lambdas are executed in FIFO order
+        std::vector< Task<> >   tasks;
+        for (int i = 0; i < 1000; ++i)
+        {
+            tasks.push_back( acc.strand.add( [&acc, i] () { acc.history.push_back( i ); }));
+        }
+
+        // coroutines are moved to the strand
+        for (int i = 0; i < 1000; ++i)
+        {
+            tasks.push_back( Deposit( acc, 2 ));
+            ts.add( tasks.back() );
+        }
+
+        for (auto& t : tasks) {
+            ts.run_until( t );
+        }
+
+        std::cout << std::dec << "balance: " << acc.balance << "\n"
+                  << "in order: " << (std::is_sorted( acc.history.begin(), acc.history.end() ) ? "yes" : "no") << ", count: " << acc.history.size() << "\n";
+    }
+}
+
+extern void  StrandSample ()
+{
+    std::cout << "\n---- 22.Strand ----\n";
+    Run();
+}
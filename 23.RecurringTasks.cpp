@@ -0,0 +1,85 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::mutex   consoleGuard;
+
+    struct World
+    {
+        std::vector<float>  positions   = std::vector<float>( 1024, 0.f );
+        std::vector<float>  velocities  = std::vector<float>( 1024, 1.f );
+        float               avgPos      = 0.f;
+        int                 aiTicks     = 0;
+    };
+
+
+    // Single coroutine frame is used for all ticks.
+    Task<>  Physics (TickClock &clock, World &world)
+    {
+        for (; co_await next_tick( clock );)
+        {
+            for (size_t i = 0; i < world.positions.size(); ++i) {
+                world.positions[i] += world.velocities[i];
+            }
+        }
+    }
+
+    // Executed after 'Physics' in each tick.
+    Task<>  AI (TickClock &clock, World &world)
+    {
+        for (; co_await next_tick( clock );)
+        {
+            float   sum = 0.f;
+            for (float p : world.positions) {
+                sum += p;
+            }
+            world.avgPos = sum / float(world.positions.size());
+            ++world.aiTicks;
+        }
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts      {2};
+        TickClock   clock;
+        World       world;
+
+        auto    physics = Physics( clock, world );
+        auto    ai      = AI( clock, world );
+
+        clock.add( ts, physics );
+        clock.add( ts, ai, physics );
+
+        size_t  allocated = 0;
+
+        // frame loop
+        for (int frame = 0; frame < 100; ++frame)
+        {
+            if ( frame == 1 )
+                allocated = task_memory_stats().totalBytes;
+
+            for (; not clock.tick();) {
+                std::this_thread::yield();
+            }
+            for (; not clock.is_tick_finished();) {
+                std::this_thread::yield();
+            }
+        }
+
+        allocated = task_memory_stats().totalBytes - allocated;
+
+        clock.stop();
+        ts.run_until( ai );
+        ts.run_until( physics );
+
+        std::cout << std::dec << "ticks: " << clock.tick_index() << ", ai ticks: " << world.aiTicks << ", avg position: " << world.avgPos << "\n"
+                  << "task memory allocated after the first tick: " << allocated << " bytes\n";
+    }
+}
+
+extern void  RecurringTasks ()
+{
+    std::cout << "\n---- 23.RecurringTasks ----\n";
+    Run();
+}
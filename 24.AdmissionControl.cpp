@@ -0,0 +1,96 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    static std::atomic<int>     counter {0};
+
+    Task<>  Job ()
+    {
+        // large frame
+        std::array< int, 256 >  data;
+        data.fill( 1 );
+
+        co_await yield_now();
+
+        int     sum = 0;
+        for (int v : data) {
+            sum += v;
+        }
+        counter.fetch_add( sum > 0 ? 1 : 0 );
+    }
+
+    // Producer is faster than workers, it is suspended when all slots are used.
+    Task<>  Producer (int count)
+    {
+        TaskSystem&     ts = *TaskSystem::current();
+
+        for (int i = 0; i < count; i += 16)
+        {
+            auto    res = co_await ts.reserve( 16 );
+
+            for (; res;) {
+                ts.add( Job(), res );
+            }
+        }
+    }
+
+
+    void  Measure (size_t limit, size_t queueLimit = ~size_t{0})
+    {
+        TaskSystem  ts {2};
+        ts.set_task_limit( limit );
+        ts.set_queue_limit( queueLimit );
+
+        counter.store( 0 );
+        reset_task_memory_peak();
+
+        const int   count = 4096;
+        ts.run_until( Producer( count ));
+
+        for (; counter.load() != count;) {
+            std::this_thread::yield();
+        }
+
+        auto    stat    = ts.stats();
+        auto    mem     = task_memory_stats();
+        std::cout << std::dec << (limit == ~size_t{0} ? "no limit" : "limit " + std::to_string( limit ))
+                  << (queueLimit == ~size_t{0} ? "" : ", queue limit " + std::to_string( queueLimit )) << ": peak task memory " << (mem.peakBytes >> 10) << " Kb, "
+                  << "producer waited " << (stat.producerWaitNs / 1'000'000) << " ms\n";
+    }
+
+
+    void  Run ()
+    {
+        Measure( ~size_t{0} );
+        Measure( 64 );
+
+        // suspended tasks are in flight, but not in the queue
+        Measure( ~size_t{0}, 32 );
+
+        // producers outside of coroutines
+        TaskSystem  ts {1};
+        ts.set_task_limit( TaskPriority::Low, 8 );
+
+        counter.store( 0 );
+        int     added = 0;
+        for (int i = 0; i < 100; ++i) {
+            added += ts.try_add( Job(), TaskPriority::Low ) ? 1 : 0;
+        }
+        for (int i = 0; i < 100; ++i) {
+            ts.add_blocking( Job(), TaskPriority::Low );
+        }
+        for (; counter.load() != added + 100;) {
+            std::this_thread::yield();
+        }
+
+        auto    stat = ts.stats();
+        std::cout << std::dec << "try_add: " << added << " added, " << stat.rejected << " rejected\n"
+                  << "add_blocking: waited " << (stat.producerWaitNs / 1'000'000) << " ms\n";
+    }
+}
+
+extern void  AdmissionControl ()
+{
+    std::cout << "\n---- 24.AdmissionControl ----\n";
+    Run();
+}
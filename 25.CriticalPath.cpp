@@ -0,0 +1,96 @@
+#include "TaskGraph.h"
+
+namespace
+{
+    void  Work (int us)
+    {
+        const auto  end = std::chrono::steady_clock::now() + std::chrono::microseconds{us};
+        for (; std::chrono::steady_clock::now() < end;) {}
+    }
+
+    Task<int>  Leaf (int us)
+    {
+        Work( us );
+        co_return us;
+    }
+
+    // Serial part of the graph.
+    Task<int>  Chain (int length)
+    {
+        int     sum = 0;
+        for (int i = 0; i < length; ++i) {
+            sum += co_await Leaf( 500 );
+        }
+        co_return sum;
+    }
+
+    Task<int>  Root ()
+    {
+        // parallel part of the graph
+        auto    [a, b, c, d] = co_await std::tuple{ Leaf( 1000 ), Leaf( 1000 ), Leaf( 1000 ), Chain( 4 )};
+        Work( 200 );
+        co_return a + b + c + d;
+    }
+
+    // Awaits the task which is already finished, the edge is recorded without suspension.
+    Task<int>  AwaitFinished ()
+    {
+        Task<int>   leaf    = Leaf( 100 );
+        int         a       = co_await leaf;
+        int         b       = co_await leaf;
+        auto [c, d]         = co_await std::tuple{ leaf, leaf };
+        co_return a + b + c + d;
+    }
+
+
+    void  Run ()
+    {
+        TaskGraphRecorder   rec;
+        {
+            TaskSystem  ts {4};
+            ts.set_recorder( &rec );
+            ts.run_until( Root() );
+
+            // worker reports the last execution after the task is complete,
+            // so the recorder is used until worker threads are stopped
+        }
+
+        const TaskGraph     graph   = rec.graph();
+        const auto          report  = analyze_critical_path( graph );
+
+        std::cout << report.to_text( graph, 3 )
+                  << to_dot( graph, report );
+    }
+
+    void  RunFinished ()
+    {
+        TaskGraphRecorder   rec;
+        {
+            TaskSystem  ts {2};
+            ts.set_recorder( &rec );
+            ts.run_until( AwaitFinished() );
+        }
+
+        const TaskGraph     graph   = rec.graph();
+        const auto          report  = analyze_critical_path( graph );
+
+        // the first edge waits for the leaf, three other edges are added when the leaf is already finished
+        size_t  resolved = 0;
+        for (auto& e : graph.edges) {
+            resolved += e.hasResumed;
+        }
+        std::cout << "await finished task: nodes: " << graph.nodes.size() << ", edges: " << graph.edges.size()
+                  << ", resolved: " << resolved << ", critical path: " << report.path.size() << " tasks\n";
+
+        assert( graph.nodes.size() == 2 );
+        assert( graph.edges.size() == 4 );
+        assert( resolved == 4 );
+    }
+}
+
+extern void  CriticalPath ()
+{
+    std::cout << "\n---- 25.CriticalPath ----\n";
+    Run();
+    RunFinished();
+}
@@ -0,0 +1,55 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    Task<int>  SmallFrame (int value)
+    {
+        co_return value + 1;
+    }
+
+    // Large array is stored in coroutine frame because it is used after suspension.
+    Task<int>  LargeFrame (int value)
+    {
+        std::array< int, 2048 >     data;
+        data.fill( value );
+
+        co_await yield_now();
+
+        int     sum = 0;
+        for (int v : data) {
+            sum += v;
+        }
+        co_return sum;
+    }
+
+    Task<int64_t>  Producer (int count)
+    {
+        std::vector< Task<int> >    tasks;
+        for (int i = 0; i < count; ++i)
+        {
+            tasks.push_back( i % 4 == 0 ? LargeFrame( i ) : SmallFrame( i ));
+            TaskSystem::current()->add( tasks.back() );
+        }
+
+        int64_t     sum = 0;
+        for (auto& t : tasks) {
+            sum += co_await t;
+        }
+        co_return sum;
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts {2};
+
+        std::cout << std::dec << "result: " << ts.run_until( Producer( 256 )) << "\n"
+                  << FrameProfiler::ReportText();
+    }
+}
+
+extern void  FrameProfilerSample ()
+{
+    std::cout << "\n---- 26.FrameProfiler ----\n";
+    Run();
+}
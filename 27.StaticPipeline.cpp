@@ -0,0 +1,107 @@
+#include "StaticPipeline.h"
+
+namespace
+{
+    // Data which is shared between stages.
+    struct Frame
+    {
+        std::array< int, 4096 >     pixels;
+        std::array< int, 4096 >     blurred;
+        std::array< int, 16 >       histogram;
+        int64_t                     edges   = 0;
+        int64_t                     result  = 0;
+        int                         index   = 0;
+    };
+
+    struct Load {
+        Frame*  frame = nullptr;
+        void  operator () () {
+            for (size_t i = 0; i < frame->pixels.size(); ++i) {
+                frame->pixels[i] = int((i * 7 + size_t(frame->index)) % 256);
+            }
+        }
+    };
+
+    struct Blur {
+        Frame*  frame = nullptr;
+        void  operator () () {
+            for (size_t i = 1; i+1 < frame->pixels.size(); ++i) {
+                frame->blurred[i] = (frame->pixels[i-1] + frame->pixels[i] + frame->pixels[i+1]) / 3;
+            }
+        }
+    };
+
+    struct Histogram {
+        Frame*  frame = nullptr;
+        void  operator () () {
+            frame->histogram.fill( 0 );
+            for (int v : frame->blurred) {
+                ++frame->histogram[ size_t(v) / 16 ];
+            }
+        }
+    };
+
+    struct Edges {
+        Frame*  frame = nullptr;
+        void  operator () () {
+            frame->edges = 0;
+            for (size_t i = 1; i < frame->blurred.size(); ++i) {
+                frame->edges += std::abs( frame->blurred[i] - frame->blurred[i-1] );
+            }
+        }
+    };
+
+    struct Combine {
+        Frame*  frame = nullptr;
+        void  operator () () {
+            frame->result = frame->edges + frame->histogram[0];
+        }
+    };
+
+    // Histogram and Edges are executed in parallel.
+    using FramePipeline = pipeline< Load, Blur, join< Histogram, Edges >, Combine >;
+
+    static_assert( FramePipeline::StageCount == 5 );
+
+
+    Task<int64_t>  ProcessFrames (FramePipeline &pipe, Frame &frame, int count)
+    {
+        int64_t     sum = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            frame.index = i;
+            pipe.start( *TaskSystem::current() );
+            co_await pipe.task();
+            sum += frame.result;
+        }
+        co_return sum;
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem  ts {4};
+
+        Frame           frame   {};     // 'Blur' does not write the first and the last values
+        FramePipeline   pipe;
+        std::apply( [&frame] (auto& ...stage) { ((stage.frame = &frame), ...); }, pipe.stages() );
+
+        // warm up
+        pipe.start( ts );
+        ts.run_until( pipe.task() );
+
+        // pipeline does not allocate memory after it is constructed, only 'ProcessFrames' coroutine allocates
+        const auto  before  = task_memory_stats();
+        const auto  result  = ts.run_until( ProcessFrames( pipe, frame, 100 ));
+        const auto  after   = task_memory_stats();
+
+        std::cout << std::dec << "result: " << result << "\n"
+                  << "allocated for tasks: " << (after.totalBytes - before.totalBytes) << " bytes in 100 runs\n";
+    }
+}
+
+extern void  StaticPipelineSample ()
+{
+    std::cout << "\n---- 27.StaticPipeline ----\n";
+    Run();
+}
@@ -0,0 +1,78 @@
+#include "MappedFile.h"
+#include <filesystem>
+#include <fstream>
+#include <charconv>
+
+namespace
+{
+    // Text file with one number per line.
+    [[nodiscard]] int64_t  WriteFile (const std::string &path, int lineCount)
+    {
+        std::ofstream   file {path};
+        int64_t         sum = 0;
+
+        for (int i = 0; i < lineCount; ++i)
+        {
+            const int   value = int((int64_t(i) * 7919) % 100'000);
+            file << value << '\n';
+            sum += value;
+        }
+        return sum;
+    }
+
+    // Parse numbers directly from mapped memory.
+    Task<>  ProcessChunk (FileChunk chunk, std::atomic<int64_t> &sum, std::atomic<int> &lines)
+    {
+        int64_t     localSum    = 0;
+        int         localLines  = 0;
+
+        for (const char* it = chunk.data.data(), *end = it + chunk.data.size(); it < end;)
+        {
+            int     value = 0;
+            auto    res   = std::from_chars( it, end, value );
+            assert( res.ec == std::errc{} and *res.ptr == '\n' );
+
+            localSum    += value;
+            localLines  += 1;
+            it           = res.ptr + 1;
+        }
+
+        sum.fetch_add( localSum );
+        lines.fetch_add( localLines );
+        co_return;
+    }
+
+
+    void  Run ()
+    {
+        const std::string   path        = (std::filesystem::temp_directory_path() / "28.MappedFile.txt").string();
+        const int64_t       expected    = WriteFile( path, 1'000'000 );
+
+        TaskSystem  ts {4};
+
+        std::atomic<int64_t>    sum     {0};
+        std::atomic<int>        lines   {0};
+        size_t                  chunks  = 0;
+        {
+            MappedFile  file {path};
+            assert( file.is_open() );
+
+            // chunk size is small to get many chunks, usually it is megabytes
+            auto    gen = read_chunks( file, 64 << 10, '\n', 4 );
+
+            ts.run_until( for_each_chunk( file, std::move(gen),
+                                          [&] (const FileChunk &c) { chunks = c.index + 1;  return ProcessChunk( c, sum, lines ); },
+                                          8 ));
+        }
+        std::filesystem::remove( path );
+
+        std::cout << std::dec << "chunks: " << chunks << ", lines: " << lines.load() << "\n"
+                  << "sum: " << sum.load() << (sum.load() == expected ? " (valid)" : " (invalid)") << "\n";
+    }
+}
+
+extern void  MappedFileSample ()
+{
+    std::cout << "\n---- 28.MappedFile ----\n";
+    Run();
+}
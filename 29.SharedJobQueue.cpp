@@ -0,0 +1,122 @@
+#include "SharedJobQueue.h"
+
+#ifdef SHARED_JOB_QUEUE_SUPPORTED
+#   include <sys/wait.h>
+
+namespace
+{
+    constexpr uint32_t  SumJob  = 1;
+
+    struct SumPayload
+    {
+        int64_t     value;
+    };
+
+
+    // Child process submits jobs, claims some of them and crashes without completing them.
+    [[noreturn]] void  ChildProcess (const std::string &name, const SharedJobQueue::Params &params)
+    {
+        SharedJobQueue  q;
+        if ( not q.open( name, params ))
+            ::_exit( 1 );
+
+        for (int i = 0; i < 50; ++i)
+        {
+            // payload is written directly to shared memory
+            auto    job = q.allocate();
+            static_cast< SumPayload* >( job.data )->value = 1000 + i;
+            q.submit( job, SumJob, sizeof(SumPayload) );
+        }
+
+        for (int i = 0; i < 10; ++i)
+        {
+            uint32_t    job;
+            uint64_t    word;
+            bool        ok = q.try_claim( job, word );
+            assert( ok );  (void)(ok);
+        }
+
+        // crash, 10 jobs are claimed but not completed, 40 jobs are in the ring
+        ::_exit( 0 );
+    }
+
+
+    void  Run ()
+    {
+        const std::string               name    = "/CoroutineSamples." + std::to_string( ::getpid() );
+        const SharedJobQueue::Params    params  { 512, 64, std::chrono::milliseconds{500} };
+
+        // Fork before the queue and the task system are created, so the child does not inherit their threads and locks.
+        // Child opens its own queue, one of the processes creates the segment and another one attaches to it.
+        std::cout.flush();
+        const pid_t     child = ::fork();
+        if ( child == 0 )
+            ChildProcess( name, params );
+
+        SharedJobQueue  q;
+        const bool      opened  = q.open( name, params );
+
+        int     status = 0;
+        ::waitpid( child, &status, 0 );
+
+        if ( not opened or not WIFEXITED( status ) or WEXITSTATUS( status ) != 0 )
+        {
+            std::cout << "failed to open shared memory\n";
+            q.close();
+            SharedJobQueue::unlink( name );
+            return;
+        }
+
+        int64_t     expected = 0;
+        for (int i = 0; i < 200; ++i)
+        {
+            SumPayload  p {i};
+            q.submit( SumJob, &p, sizeof(p) );
+            expected += i;
+        }
+        for (int i = 0; i < 50; ++i) {
+            expected += 1000 + i;
+        }
+
+        std::atomic<int64_t>    sum {0};
+        q.set_handler( SumJob, [&sum] (const SharedJobQueue::JobView &job)
+            {
+                sum.fetch_add( static_cast< const SumPayload* >( job.data )->value );
+            });
+
+        {
+            TaskSystem  ts {2};
+
+            // usually it is called periodically by a dedicated thread or 'TickClock'
+            for (; q.stats().executed < 250;)
+            {
+                q.poll( ts, 16 );
+                std::this_thread::yield();
+            }
+        }
+
+        const auto  stats = q.stats();
+        q.close();
+        SharedJobQueue::unlink( name );
+
+        std::cout << std::dec << "executed: " << stats.executed << ", stolen: " << stats.stolen
+                  << ", reclaimed: " << stats.reclaimed << " from " << stats.deadPeers << " dead process\n"
+                  << "sum: " << sum.load() << (sum.load() == expected ? " (valid)" : " (invalid)") << "\n";
+    }
+}
+
+extern void  SharedJobQueueSample ()
+{
+    std::cout << "\n---- 29.SharedJobQueue ----\n";
+    Run();
+}
+
+#else
+
+extern void  SharedJobQueueSample ()
+{
+    std::cout << "\n---- 29.SharedJobQueue ----\n"
+              << "requires POSIX shared memory\n";
+}
+
+#endif // SHARED_JOB_QUEUE_SUPPORTED
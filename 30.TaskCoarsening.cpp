@@ -0,0 +1,92 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    // Few hundred nanoseconds of work, overhead of the task system is comparable with the work.
+    Task<int>  Tiny (int value)
+    {
+        uint32_t    sum = uint32_t(value);
+        for (uint32_t i = 0; i < 64; ++i) {
+            sum = sum * 31 + i;
+        }
+        co_return int(sum);
+    }
+
+    // Large task, must not be batched.
+    Task<int>  Heavy (int value)
+    {
+        const auto  end = std::chrono::steady_clock::now() + std::chrono::microseconds{50};
+        for (; std::chrono::steady_clock::now() < end;) {}
+        co_return value;
+    }
+
+
+    [[nodiscard]] double  Execute (TaskSystem &ts, int count)
+    {
+        std::vector< Task<int> >    tasks;
+        tasks.reserve( size_t(count) );
+
+        for (int i = 0; i < count; ++i) {
+            tasks.push_back( i % 256 == 0 ? Heavy( i ) : Tiny( i ));
+        }
+
+        const auto  start = std::chrono::steady_clock::now();
+        ts.add( tasks );
+
+        for (auto& t : tasks) {
+            ts.run_until( t );
+        }
+        return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    }
+
+    [[nodiscard]] double  Best (TaskSystem &ts, int count, int runs)
+    {
+        double  best = Execute( ts, count );
+        for (int i = 1; i < runs; ++i) {
+            best = std::min( best, Execute( ts, count ));
+        }
+        return best;
+    }
+
+
+    void  Run ()
+    {
+        constexpr int   count   = 100'000;
+        constexpr int   runs    = 3;
+
+        TaskSystem  ts {4};
+
+        // both modes are measured after the same warm-up run
+        (void)Execute( ts, count );
+        const double    plainMs = Best( ts, count, runs );
+
+        ts.set_coarsening( true, std::chrono::microseconds{2}, 32 );
+
+        // with coarsening the warm-up run also measures durations, types become fine-grained
+        (void)Execute( ts, count );
+
+        const auto      before      = ts.stats();
+        const double    coarseMs    = Best( ts, count, runs );
+        const auto      after       = ts.stats();
+
+        // Batch saves the queue lock, clock reads and updates of shared counters and type stats,
+        // the work which is left per task is the same, so the gain depends on the number of cores
+        // and on the cost of contended atomics, it can be small or none.
+        // local stream, so the format does not affect other samples
+        std::ostringstream  str;
+        str << std::fixed << std::setprecision( 2 )
+            << "best of " << runs << " runs\n"
+            << "without coarsening: " << plainMs << " ms\n"
+            << "with coarsening:    " << coarseMs << " ms, " << (after.batches - before.batches) / runs << " batches, "
+            << (after.batchedTasks - before.batchedTasks) / runs << " of " << count << " tasks are batched per run\n"
+            << "coarsening speedup: " << (plainMs / coarseMs) << "x\n"
+            << ts.type_stats_text( 4 );
+        std::cout << str.str();
+    }
+}
+
+extern void  TaskCoarsening ()
+{
+    std::cout << "\n---- 30.TaskCoarsening ----\n";
+    Run();
+}
@@ -0,0 +1,74 @@
+#include "AwaitProfiler.h"
+
+namespace
+{
+    void  Spin (std::chrono::microseconds time)
+    {
+        const auto  end = std::chrono::steady_clock::now() + time;
+        for (; std::chrono::steady_clock::now() < end;) {}
+    }
+
+    Task<>  Tokenize ()
+    {
+        Spin( std::chrono::microseconds{300} );
+        co_return;
+    }
+
+    Task<>  Layout ()
+    {
+        Spin( std::chrono::microseconds{900} );
+        co_return;
+    }
+
+    Task<>  Parse ()
+    {
+        co_await Tokenize();
+        Spin( std::chrono::microseconds{100} );
+    }
+
+    Task<>  Render ()
+    {
+        co_await Layout();
+    }
+
+    // Native profiler shows 'Tokenize' and 'Layout' without callers, because they are resumed by workers.
+    Task<>  Frame ()
+    {
+        co_await Parse();
+        co_await Render();
+    }
+
+    Task<>  Frames (int count)
+    {
+        std::vector< Task<> >   frames;
+        for (int i = 0; i < count; ++i)
+        {
+            frames.push_back( Frame() );
+            TaskSystem::current()->add( frames.back() );
+        }
+        for (auto& f : frames) {
+            co_await f;
+        }
+    }
+
+
+    void  Run ()
+    {
+        TaskSystem      ts {2};
+        AwaitProfiler   profiler {ts, std::chrono::microseconds{200}};
+
+        profiler.start();
+        ts.run_until( Frames( 200 ));
+        profiler.stop();
+
+        // can be saved to file and converted by 'flamegraph.pl'
+        std::cout << "samples: " << profiler.sample_count() << "\n"
+                  << profiler.folded();
+    }
+}
+
+extern void  AwaitProfilerSample ()
+{
+    std::cout << "\n---- 31.AwaitProfiler ----\n";
+    Run();
+}
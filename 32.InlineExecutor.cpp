@@ -0,0 +1,106 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    // Tasks are executed in one thread, so 'order' is not protected.
+    Task<>  Step (std::vector<int> &order, int index)
+    {
+        order.push_back( index );
+        co_return;
+    }
+
+    Task<>  Steps (std::vector<int> &order, int count)
+    {
+        std::vector< Task<> >   steps;
+        for (int i = 0; i < count; ++i)
+        {
+            steps.push_back( Step( order, i ));
+            TaskSystem::current()->add( steps.back() );
+        }
+        for (auto& s : steps) {
+            co_await s;
+        }
+    }
+
+    [[nodiscard]] std::vector<int>  RunSteps (uint32_t seed)
+    {
+        TaskSystem          ts {0};
+        std::vector<int>    order;
+
+        ts.set_inline_seed( seed );
+        ts.run_until( Steps( order, 10 ));
+        return order;
+    }
+
+
+    Task<int64_t>  SumRange (std::span<const int> values)
+    {
+        int64_t     sum = 0;
+        for (int v : values) {
+            sum += v;
+        }
+        co_return sum;
+    }
+
+    // Fan-out which is used for any amount of work.
+    Task<int64_t>  Sum (std::span<const int> values)
+    {
+        constexpr size_t            partSize = 4096;
+        std::vector< Task<int64_t> >  parts;
+
+        for (size_t i = 0; i < values.size(); i += partSize)
+        {
+            parts.push_back( SumRange( values.subspan( i, std::min( partSize, values.size() - i ))));
+            TaskSystem::current()->add( parts.back() );
+        }
+
+        int64_t     sum = 0;
+        for (auto& p : parts) {
+            sum += co_await p;
+        }
+        co_return sum;
+    }
+
+
+    void  Run ()
+    {
+        const auto  Print = [] (const char* name, const std::vector<int> &order)
+        {
+            std::cout << name;
+            for (int i : order) {
+                std::cout << " " << i;
+            }
+            std::cout << "\n";
+        };
+
+        Print( "fifo:         ", RunSteps( 0 ));
+        Print( "seed 7:       ", RunSteps( 7 ));
+        Print( "seed 7 again: ", RunSteps( 7 ));
+        Print( "seed 8:       ", RunSteps( 8 ));
+
+        TaskSystem          inlineTs    {0};
+        TaskSystem          parallelTs  {4};
+        InlineHeuristic     site        {std::chrono::microseconds{200}};
+
+        const std::vector<int>  values ( 4'000'000, 1 );
+
+        for (size_t count : { 1'000, 10'000, 1'000, 100'000, 4'000'000, 2'000 })
+        {
+            TaskSystem&     ts      = site.select( count, inlineTs, parallelTs );
+            const auto      start   = std::chrono::steady_clock::now();
+            const int64_t   sum     = ts.run_until( Sum( std::span{ values.data(), count }));
+            const auto      elapsed = std::chrono::steady_clock::now() - start;
+
+            site.record( ts, count, elapsed );
+
+            std::cout << std::dec << count << " items: " << (ts.is_inline() ? "inline  " : "parallel")
+                      << ", sum " << sum << ", " << std::chrono::duration_cast< std::chrono::microseconds >( elapsed ).count() << " us\n";
+        }
+    }
+}
+
+extern void  InlineExecutor ()
+{
+    std::cout << "\n---- 32.InlineExecutor ----\n";
+    Run();
+}
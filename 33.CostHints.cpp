@@ -0,0 +1,99 @@
+#include "TaskSystem.h"
+
+namespace
+{
+    // Sleep is used instead of computation, so makespan does not depend on number of CPU cores.
+    Task<>  Light ()
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds{1} );
+        co_return;
+    }
+
+    Task<>  Heavy ()
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds{10} );
+        co_return;
+    }
+
+    // Cost hint is a parameter of the coroutine.
+    Task<>  Hinted (TaskCost cost)
+    {
+        std::this_thread::sleep_for( cost.value );
+        co_return;
+    }
+
+
+    // Skewed workload, the heavy tasks are at the end.
+    [[nodiscard]] std::vector< Task<> >  MakeTasks (bool hinted)
+    {
+        std::vector< Task<> >   tasks;
+        for (int i = 0; i < 40; ++i) {
+            tasks.push_back( hinted ? Hinted( TaskCost{ std::chrono::milliseconds{1} }) : Light() );
+        }
+        for (int i = 0; i < 6; ++i) {
+            tasks.push_back( hinted ? Hinted( TaskCost{ std::chrono::milliseconds{10} }) : Heavy() );
+        }
+        return tasks;
+    }
+
+    // All tasks are spawned by one worker, so they are in its queue and other workers steal them.
+    Task<>  Spawn (std::vector< Task<> > &tasks)
+    {
+        for (auto& t : tasks) {
+            TaskSystem::current()->add( t );
+        }
+        for (auto& t : tasks) {
+            co_await t;
+        }
+    }
+
+    [[nodiscard]] double  Makespan (TaskSystem &ts, bool hinted, bool bulk)
+    {
+        auto        tasks   = MakeTasks( hinted );
+        const auto  start   = std::chrono::steady_clock::now();
+
+        if ( bulk )
+        {
+            ts.add( tasks );
+            for (auto& t : tasks) {
+                ts.run_until( t );
+            }
+        }
+        else
+            ts.run_until( Spawn( tasks ));
+
+        return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    }
+
+
+    void  Run ()
+    {
+        for (bool bulk : { false, true })
+        {
+            TaskSystem  ts {4};
+
+            const double    plainMs     = Makespan( ts, false, bulk );
+
+            ts.set_cost_balancing( true );
+            const double    hintedMs    = Makespan( ts, true, bulk );
+
+            // the first run measures durations of 'Light' and 'Heavy'
+            (void)Makespan( ts, false, bulk );
+            const double    learnedMs   = Makespan( ts, false, bulk );
+
+            // local stream, so the format does not affect other samples
+            std::ostringstream  str;
+            str << std::fixed << std::setprecision( 1 )
+                << (bulk ? "bulk add:  " : "spawned:   ")
+                << "without costs " << plainMs << " ms, with hints " << hintedMs
+                << " ms, with learned costs " << learnedMs << " ms\n";
+            std::cout << str.str();
+        }
+    }
+}
+
+extern void  CostHints ()
+{
+    std::cout << "\n---- 33.CostHints ----\n";
+    Run();
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "TaskSystem.h"
+#include <map>
+#include <unordered_map>
+
+
+// Sampling profiler for logical call chains of coroutines.
+// Native profilers show only 'process_tasks -> run -> resume', because each coroutine is resumed by the scheduler.
+// Profiler periodically takes the task which is executed by each worker and walks tasks which wait for it
+// (coroutine which awaits a task is in the waiter list of the task), so the chain is a logical async call stack.
+// Output is in folded stack format: 'root;caller;callee count', it can be used by 'flamegraph.pl'.
+//
+// Coroutines are named by 'std::source_location' which is captured when the coroutine is created,
+// so names are resolved in-process without debug info or 'addr2line'.
+// Tasks which are executed by non-worker threads in 'run_until()' are not sampled.
+struct AwaitProfiler
+{
+private:
+    using Chain_t = std::vector< const void* >;    // type ids from root to the running task
+
+    static constexpr size_t     MaxDepth    = 64;
+
+    TaskSystem&                                 _ts;
+    const std::chrono::microseconds             _period;
+
+    std::thread                                 _thread;
+    std::atomic<bool>                           _looping    {false};
+
+    mutable std::mutex                          _guard;
+    std::map< Chain_t, size_t >                 _stacks;
+    std::unordered_map< const void*, std::string >  _names;
+    size_t                                      _samples    = 0;    // number of sampled workers, including idle
+    size_t                                      _idle       = 0;
+
+public:
+    explicit AwaitProfiler (TaskSystem &ts, std::chrono::microseconds period = std::chrono::microseconds{1000}) :
+        _ts{ts}, _period{period}
+    {}
+
+    ~AwaitProfiler ()                                       { stop(); }
+
+    AwaitProfiler (const AwaitProfiler &) = delete;
+    AwaitProfiler&  operator = (const AwaitProfiler &) = delete;
+
+    void  start ();
+    void  stop ();
+    void  clear ();
+
+    // Take one sample of all workers, called by the profiler thread.
+    void  sample ();
+
+    // Returns folded stacks sorted by number of samples, 'idle' samples are included.
+    [[nodiscard]] std::string  folded () const;
+
+    [[nodiscard]] size_t  sample_count () const             { std::scoped_lock lock{_guard};  return _samples; }
+    [[nodiscard]] size_t  idle_count ()   const             { std::scoped_lock lock{_guard};  return _idle; }
+
+private:
+    void  walk (RC<AsyncTask> task, Chain_t &chain);
+};
+
+
+inline void  AwaitProfiler::start ()
+{
+    assert( not _thread.joinable() );
+
+    _ts._samplers.fetch_add( 1 );
+    _looping.store( true );
+
+    _thread = std::thread{ [this] ()
+        {
+            for (auto next = std::chrono::steady_clock::now(); _looping.load();)
+            {
+                next += _period;
+                sample();
+                std::this_thread::sleep_until( next );
+            }
+        }};
+}
+
+
+inline void  AwaitProfiler::stop ()
+{
+    if ( not _thread.joinable() )
+        return;
+
+    _looping.store( false );
+    _thread.join();
+    _ts._samplers.fetch_sub( 1 );
+}
+
+
+inline void  AwaitProfiler::clear ()
+{
+    std::scoped_lock    lock {_guard};
+    _stacks.clear();
+    _samples    = 0;
+    _idle       = 0;
+}
+
+
+inline void  AwaitProfiler::sample ()
+{
+    Chain_t     chain;
+    chain.reserve( MaxDepth );
+
+    for (int i = 0; i < _ts._queueCount; ++i)
+    {
+        auto&           q = _ts._queues[i];
+        RC<AsyncTask>   task;
+        {
+            // worker holds a reference while the task is published
+            std::scoped_lock    lock {q.runningGuard};
+            task = RC<AsyncTask>{ q.running };
+        }
+
+        chain.clear();
+        if ( task )
+            walk( std::move(task), chain );
+
+        std::scoped_lock    lock {_guard};
+        ++_samples;
+
+        if ( chain.empty() )
+            ++_idle;
+        else
+            ++_stacks[ chain ];
+    }
+}
+
+
+// Walk from the running task to the root, names are resolved while tasks are alive.
+inline void  AwaitProfiler::walk (RC<AsyncTask> task, Chain_t &chain)
+{
+    for (; task and chain.size() < MaxDepth;)
+    {
+        const void*     id = task->type_id();
+        {
+            std::scoped_lock    lock {_guard};
+            if ( not _names.contains( id ))
+                _names.emplace( id, task->type_name() );
+        }
+        chain.push_back( id );
+
+        // the first waiter is the caller, others are fan-in of the same task
+        RC<AsyncTask>   caller;
+        {
+            std::scoped_lock    lock {task->_waitersGuard};
+            if ( not task->_waiters.empty() )
+                caller = task->_waiters.front();
+        }
+        task = std::move(caller);
+    }
+    std::reverse( chain.begin(), chain.end() );
+}
+
+
+inline std::string  AwaitProfiler::folded () const
+{
+    std::scoped_lock    lock {_guard};
+
+    std::vector< std::pair< std::string, size_t >>  lines;
+    for (auto& [chain, count] : _stacks)
+    {
+        std::string     line;
+        for (const void* id : chain)
+        {
+            std::string     name = _names.at( id );
+
+            // separators of the folded format
+            std::replace( name.begin(), name.end(), ';', ':' );
+            line += (line.empty() ? "" : ";") + name;
+        }
+        lines.emplace_back( std::move(line), count );
+    }
+    if ( _idle > 0 )
+        lines.emplace_back( "[idle]", _idle );
+
+    std::sort( lines.begin(), lines.end(), [] (auto& lhs, auto& rhs) { return lhs.second > rhs.second; });
+
+    std::string     result;
+    for (auto& [line, count] : lines) {
+        result += line + " " + std::to_string( count ) + "\n";
+    }
+    return result;
+}
@@ -0,0 +1,438 @@
+// Scheduler stress test: executes generated or recorded task graphs on TaskSystem
+// and reports makespan, throughput and task latency for each thread count.
+//
+// Graph file format, one task per line, dependencies must be declared before the task:
+//   # comment
+//   <id> <cpu_us> <mem_bytes> <dep_id> <dep_id> ...
+//
+// Usage:
+//   DagBench [--threads 1,2,4] [--repeat 3] [--load file] [--save file]
+//            [--depth 32] [--width 64] [--fanin 1:4] [--fanin-dist uniform|geometric]
+//            [--cpu-us 20] [--mem 0] [--mem-dist fixed|uniform|exponential] [--seed 1]
+
+#include "TaskSystem.h"
+#include <fstream>
+#include <cstdio>
+#include <random>
+#include <limits>
+#include <iomanip>
+
+namespace
+{
+    using Clock_t = std::chrono::steady_clock;
+
+    struct Node
+    {
+        uint32_t                cpuUs   = 0;
+        uint32_t                memBytes= 0;
+        std::vector<uint32_t>   deps;
+    };
+
+    struct Graph
+    {
+        std::vector< Node >     nodes;
+    };
+
+    enum class MemDist
+    {
+        Fixed,
+        Uniform,        // from 0 to 2 * mean
+        Exponential,
+    };
+
+    struct GenParams
+    {
+        int         depth       = 32;
+        int         width       = 64;
+        int         faninMin    = 1;
+        int         faninMax    = 4;
+        bool        geometric   = false;    // fan-in distribution, most tasks have few dependencies
+        double      cpuUs       = 20.0;     // mean of exponential distribution
+        double      memBytes    = 0.0;      // mean of 'memDist'
+        MemDist     memDist     = MemDist::Fixed;
+        uint32_t    seed        = 1;
+    };
+
+    // Limits of values in the loaded graph.
+    static constexpr int64_t    MaxCpuUs    = 10'000'000;   // 10 s
+    static constexpr int64_t    MaxMemBytes = 1 << 30;      // 1 GiB
+
+
+    // Layered random DAG, each task depends on tasks from previous layers.
+    // Fan-out is the result of random fan-in, tasks in the previous layer are preferred.
+    [[nodiscard]] Graph  Generate (const GenParams &p)
+    {
+        std::mt19937                            rnd         {p.seed};
+        std::exponential_distribution<double>   cpuDist     {1.0 / std::max( p.cpuUs, 0.001 )};
+        std::exponential_distribution<double>   memExp      {1.0 / std::max( p.memBytes, 0.001 )};
+        std::uniform_real_distribution<double>  memUni      {0.0, 2.0 * p.memBytes};
+        std::uniform_int_distribution<int>      faninUni    {p.faninMin, p.faninMax};
+        std::geometric_distribution<int>        faninGeo    {0.5};
+        std::uniform_real_distribution<double>  unit        {0.0, 1.0};
+
+        Graph   g;
+        g.nodes.reserve( size_t(p.depth) * size_t(p.width) );
+
+        for (int layer = 0; layer < p.depth; ++layer)
+        {
+            const uint32_t  layerBegin = uint32_t(g.nodes.size());
+
+            for (int i = 0; i < p.width; ++i)
+            {
+                Node    n;
+                n.cpuUs     = uint32_t(cpuDist( rnd ));
+
+                switch ( p.memDist )
+                {
+                    case MemDist::Fixed :       n.memBytes = uint32_t(p.memBytes);  break;
+                    case MemDist::Uniform :     n.memBytes = uint32_t(memUni( rnd ));  break;
+                    case MemDist::Exponential : n.memBytes = uint32_t(std::min( memExp( rnd ), double(MaxMemBytes) ));  break;
+                }
+
+                if ( layer > 0 )
+                {
+                    const int   fanin = p.geometric ? std::min( p.faninMin + faninGeo( rnd ), p.faninMax ) : faninUni( rnd );
+
+                    for (int d = 0; d < fanin; ++d)
+                    {
+                        // 75% from the previous layer
+                        const uint32_t  lo  = (unit( rnd ) < 0.75 ? layerBegin - uint32_t(p.width) : 0);
+                        const uint32_t  dep = lo + uint32_t(unit( rnd ) * (layerBegin - lo));
+
+                        if ( std::find( n.deps.begin(), n.deps.end(), dep ) == n.deps.end() )
+                            n.deps.push_back( dep );
+                    }
+                }
+                g.nodes.push_back( std::move(n) );
+            }
+        }
+        return g;
+    }
+
+
+    // Errors are printed with line number.
+    [[nodiscard]] bool  Load (const std::string &path, Graph &g)
+    {
+        std::ifstream   file {path};
+        if ( not file )
+            return false;
+
+        std::unordered_map< uint64_t, uint32_t >    idMap;
+        std::string                                 line;
+        size_t                                      lineNum = 0;
+
+        const auto  Error = [&] (const char* msg)
+        {
+            std::cerr << path << ":" << lineNum << ": " << msg << "\n";
+            return false;
+        };
+
+        for (; std::getline( file, line );)
+        {
+            ++lineNum;
+            if ( line.empty() or line[0] == '#' )
+                continue;
+
+            std::stringstream   str {line};
+            uint64_t            id;
+            int64_t             cpuUs;
+            int64_t             memBytes;
+            Node                n;
+
+            if ( not (str >> id >> cpuUs >> memBytes) )
+                return Error( "expected <id> <cpu_us> <mem_bytes>" );
+
+            if ( cpuUs < 0 or cpuUs > MaxCpuUs )
+                return Error( "cpu_us is negative or greater than 10 s" );
+
+            if ( memBytes < 0 or memBytes > MaxMemBytes )
+                return Error( "mem_bytes is negative or greater than 1 GiB" );
+
+            n.cpuUs     = uint32_t(cpuUs);
+            n.memBytes  = uint32_t(memBytes);
+
+            for (uint64_t dep; str >> dep;)
+            {
+                auto    it = idMap.find( dep );
+                if ( it == idMap.end() )
+                    return Error( "dependency must be declared before the task" );
+
+                n.deps.push_back( it->second );
+            }
+
+            if ( not str.eof() )
+                return Error( "invalid dependency id" );
+
+            if ( not idMap.emplace( id, uint32_t(g.nodes.size()) ).second )
+                return Error( "duplicate id" );
+
+            g.nodes.push_back( std::move(n) );
+        }
+        return true;
+    }
+
+
+    [[nodiscard]] bool  Save (const std::string &path, const Graph &g)
+    {
+        std::ofstream   file {path};
+        if ( not file )
+            return false;
+
+        file << "# id cpu_us mem_bytes deps...\n";
+        for (size_t i = 0; i < g.nodes.size(); ++i)
+        {
+            const auto&     n = g.nodes[i];
+            file << i << ' ' << n.cpuUs << ' ' << n.memBytes;
+            for (uint32_t d : n.deps) {
+                file << ' ' << d;
+            }
+            file << '\n';
+        }
+        return bool(file);
+    }
+
+
+    // Shared between tasks of the single run.
+    struct RunState
+    {
+        const Graph&                        graph;
+        Clock_t::time_point                 submit;
+        std::vector< Clock_t::time_point >  finish;     // written once by each task
+        std::vector< int64_t >              latencyNs;  // from ready to start
+
+        // Main thread waits without executing tasks, so it does not add one more thread to the measured count.
+        std::atomic<size_t>                 remaining;
+        std::mutex                          guard;
+        std::condition_variable             completeCV;
+        bool                                complete    = false;
+
+        explicit RunState (const Graph &g) : graph{g}, finish( g.nodes.size() ), latencyNs( g.nodes.size() ), remaining{ g.nodes.size() } {}
+    };
+
+
+    void  Spin (uint32_t us)
+    {
+        const auto  end = Clock_t::now() + std::chrono::microseconds{us};
+        for (; Clock_t::now() < end;) {}
+    }
+
+    Task<>  Execute (RunState &rs, uint32_t id, std::vector< Task<> > deps)
+    {
+        for (auto& d : deps) {
+            co_await d;
+        }
+
+        const auto      start   = Clock_t::now();
+        const auto&     node    = rs.graph.nodes[id];
+
+        // task is ready when the last dependency is finished
+        auto    ready = rs.submit;
+        for (uint32_t d : node.deps) {
+            ready = std::max( ready, rs.finish[d] );
+        }
+        rs.latencyNs[id] = std::chrono::duration_cast<std::chrono::nanoseconds>( start - ready ).count();
+
+        if ( node.memBytes > 0 )
+        {
+            std::vector<char>   mem ( node.memBytes );
+            for (size_t i = 0; i < mem.size(); i += 64) {
+                mem[i] = char(i);
+            }
+        }
+        Spin( node.cpuUs );
+
+        rs.finish[id] = Clock_t::now();
+
+        if ( rs.remaining.fetch_sub( 1 ) == 1 )
+        {
+            std::scoped_lock    lock {rs.guard};
+            rs.complete = true;
+            rs.completeCV.notify_one();
+        }
+    }
+
+
+    struct Result
+    {
+        double      makespanMs  = 0.0;
+        double      throughput  = 0.0;  // tasks per second
+        double      p50Us       = 0.0;
+        double      p99Us       = 0.0;
+        double      p999Us      = 0.0;
+    };
+
+    [[nodiscard]] Result  Run (const Graph &g, int threadCount)
+    {
+        RunState    rs {g};
+        TaskSystem  ts {threadCount};
+
+        // create all tasks before submission
+        std::vector< Task<> >   tasks;
+        tasks.reserve( g.nodes.size() );
+
+        for (uint32_t i = 0; i < g.nodes.size(); ++i)
+        {
+            std::vector< Task<> >   deps;
+            for (uint32_t d : g.nodes[i].deps) {
+                deps.push_back( tasks[d] );
+            }
+            tasks.push_back( Execute( rs, i, std::move(deps) ));
+        }
+
+        rs.submit = Clock_t::now();
+        ts.add( tasks );
+        {
+            std::unique_lock    lock {rs.guard};
+            rs.completeCV.wait( lock, [&rs] () { return rs.complete; });
+        }
+
+        const auto  makespan = Clock_t::now() - rs.submit;
+
+        std::sort( rs.latencyNs.begin(), rs.latencyNs.end() );
+        const auto  Percentile = [&] (double p) {
+            return double(rs.latencyNs[ std::min( rs.latencyNs.size()-1, size_t(p * double(rs.latencyNs.size())) )]) / 1000.0;
+        };
+
+        Result  res;
+        res.makespanMs  = std::chrono::duration<double, std::milli>( makespan ).count();
+        res.throughput  = double(g.nodes.size()) / std::chrono::duration<double>( makespan ).count();
+        res.p50Us       = Percentile( 0.5 );
+        res.p99Us       = Percentile( 0.99 );
+        res.p999Us      = Percentile( 0.999 );
+        return res;
+    }
+
+
+    [[nodiscard]] std::vector<int>  ParseList (const std::string &str)
+    {
+        std::vector<int>    result;
+        std::stringstream   ss {str};
+        for (std::string item; std::getline( ss, item, ',' );) {
+            result.push_back( std::stoi( item ));
+        }
+        return result;
+    }
+}
+
+
+int  main (int argc, char** argv)
+{
+    GenParams           gen;
+    std::vector<int>    threads     = { 1, 2, 4, int(std::thread::hardware_concurrency()) };
+    int                 repeat      = 3;
+    std::string         loadPath, savePath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string   arg     = argv[i];
+        const std::string   value   = (i+1 < argc ? argv[i+1] : "");
+
+        if ( arg == "--threads" )           { threads = ParseList( value );  ++i; }
+        else if ( arg == "--repeat" )       { repeat = std::stoi( value );  ++i; }
+        else if ( arg == "--load" )         { loadPath = value;  ++i; }
+        else if ( arg == "--save" )         { savePath = value;  ++i; }
+        else if ( arg == "--depth" )        { gen.depth = std::stoi( value );  ++i; }
+        else if ( arg == "--width" )        { gen.width = std::stoi( value );  ++i; }
+        else if ( arg == "--fanin" )
+        {
+            if ( std::sscanf( value.c_str(), "%d:%d", &gen.faninMin, &gen.faninMax ) != 2 or gen.faninMin < 0 or gen.faninMin > gen.faninMax )
+            {
+                std::cerr << "invalid fanin '" << value << "', expected <min>:<max>\n";
+                return 1;
+            }
+            ++i;
+        }
+        else if ( arg == "--fanin-dist" )   { gen.geometric = (value == "geometric");  ++i; }
+        else if ( arg == "--cpu-us" )       { gen.cpuUs = std::stod( value );  ++i; }
+        else if ( arg == "--mem" )          { gen.memBytes = std::stod( value );  ++i; }
+        else if ( arg == "--mem-dist" )
+        {
+            if ( value == "fixed" )             gen.memDist = MemDist::Fixed;
+            else if ( value == "uniform" )      gen.memDist = MemDist::Uniform;
+            else if ( value == "exponential" )  gen.memDist = MemDist::Exponential;
+            else
+            {
+                std::cerr << "invalid mem-dist '" << value << "', expected fixed, uniform or exponential\n";
+                return 1;
+            }
+            ++i;
+        }
+        else if ( arg == "--seed" )         { gen.seed = uint32_t(std::stoul( value ));  ++i; }
+        else
+        {
+            std::cerr << "unknown argument: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if ( repeat < 1 or gen.depth < 1 or gen.width < 1 or not (gen.cpuUs >= 0.0) or
+         not (gen.memBytes >= 0.0 and gen.memBytes <= double(MaxMemBytes) / 2.0) )
+    {
+        std::cerr << "invalid arguments, repeat, depth and width must be positive, cpu-us must not be negative, mem must be in range [0, 512 MiB]\n";
+        return 1;
+    }
+
+    // 'hardware_concurrency()' may return 0, thread count 0 is an inline task system without worker threads
+    std::erase_if( threads, [] (int tc) { return tc < 1; });
+    if ( threads.empty() )
+    {
+        std::cerr << "no valid thread count\n";
+        return 1;
+    }
+
+    Graph   graph;
+    if ( not loadPath.empty() )
+    {
+        if ( not Load( loadPath, graph ))
+        {
+            std::cerr << "failed to load graph from '" << loadPath << "'\n";
+            return 1;
+        }
+    }
+    else
+        graph = Generate( gen );
+
+    if ( graph.nodes.empty() )
+    {
+        std::cerr << "graph is empty\n";
+        return 1;
+    }
+
+    if ( not savePath.empty() and not Save( savePath, graph ))
+    {
+        std::cerr << "failed to save graph to '" << savePath << "'\n";
+        return 1;
+    }
+
+    size_t  edges = 0;
+    double  work  = 0.0;
+    for (auto& n : graph.nodes)
+    {
+        edges += n.deps.size();
+        work  += n.cpuUs;
+    }
+    std::cout << "tasks: " << graph.nodes.size() << ", edges: " << edges << ", cpu work: " << work / 1000.0 << " ms\n\n"
+              << "threads  makespan ms   tasks/s    p50 us    p99 us   p999 us\n"
+              << std::fixed << std::setprecision( 2 );
+
+    std::sort( threads.begin(), threads.end() );
+    threads.erase( std::unique( threads.begin(), threads.end() ), threads.end() );
+
+    for (int tc : threads)
+    {
+        // the best run is less affected by other processes
+        Result  best;
+        best.makespanMs = std::numeric_limits<double>::max();
+
+        for (int r = 0; r < repeat; ++r)
+        {
+            Result  res = Run( graph, tc );
+            if ( res.makespanMs < best.makespanMs )
+                best = res;
+        }
+
+        std::cout << std::setw(7) << tc << std::setw(13) << best.makespanMs << std::setw(10) << size_t(best.throughput)
+                  << std::setw(10) << best.p50Us << std::setw(10) << best.p99Us << std::setw(10) << best.p999Us << "\n";
+    }
+    return 0;
+}
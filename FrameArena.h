@@ -0,0 +1,346 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <utility>
+
+
+// Linear allocator for short-lived coroutine frames and dependency arrays.
+// Memory is bump-allocated from per-thread chunks and reclaimed all at once by 'reset()'.
+// Deallocation only decrements the counter of live allocations.
+// Allocations have no header, chunks are aligned to 'Granule' and each granule of the chunk is registered
+// in the global lock-free hash table, so deallocation finds the chunk by the masked pointer in O(1).
+// The search is skipped while there are no arenas, so heap allocations have no overhead.
+struct FrameArena
+{
+private:
+    static constexpr size_t     Align       = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    static constexpr size_t     Granule     = 64 << 10;
+    static constexpr size_t     TableSize   = 1 << 14;  // power of 2, table is filled up to half, it is 512 MiB of chunks
+
+    // Table entry is granule address + index of the granule in the chunk.
+    static constexpr uintptr_t  EmptyEntry      = 0;
+    static constexpr uintptr_t  RemovedEntry    = 1;
+
+public:
+    // Slot 0 is shared between all non-worker threads, other slots are owned by worker threads.
+    static constexpr int        MaxSlots    = 33;
+
+private:
+    struct Chunk
+    {
+        FrameArena*     arena   = nullptr;
+        Chunk*          next    = nullptr;
+        size_t          size    = 0;
+        size_t          offset  = 0;
+
+        [[nodiscard]] std::byte*  data ()   { return reinterpret_cast<std::byte*>(this) + _AlignUp( sizeof(Chunk) ); }
+    };
+
+    struct alignas(64) Slot
+    {
+        Chunk*      first   = nullptr;
+        Chunk*      current = nullptr;
+    };
+
+    std::mutex              _sharedGuard;       // for slot 0
+    Slot                    _slots [MaxSlots];
+    const size_t            _chunkSize;
+
+    std::atomic<size_t>     _liveCount  {0};
+    std::atomic<size_t>     _usedBytes  {0};
+
+  #ifndef NDEBUG
+    // Detects allocation which is concurrent with 'reset()'.
+    std::atomic<int>        _allocating {0};
+    std::atomic<bool>       _resetting  {false};
+  #endif
+
+    // Granules of chunks of all arenas. Entries are changed only when chunk is allocated or released,
+    // removed entry is marked, so lock-free search never misses an entry which is added before.
+    static inline std::mutex                _tableGuard;
+    static inline std::atomic<uintptr_t>    _table [TableSize] = {};
+    static inline size_t                    _tableCount     = 0;    // protected by '_tableGuard'
+    static inline std::atomic<int>          _arenaCount     {0};
+
+public:
+    // 'chunkSize' includes chunk header and is rounded up to multiple of 64 KiB.
+    explicit FrameArena (size_t chunkSize = 64 << 10);
+    ~FrameArena ();
+
+    FrameArena (const FrameArena &) = delete;
+    FrameArena&  operator = (const FrameArena &) = delete;
+
+    // Reclaim all memory if all tasks which are allocated in the arena are released, otherwise returns 'false'.
+    // Worker thread may hold the last reference to a completed task for a short time,
+    // so the caller should retry later, for example in the next frame, instead of waiting.
+    // Must not be called while any thread can allocate in the arena: the arena scope must be closed
+    // and tasks which are created inside the scope must not spawn new tasks, it is checked in debug build.
+    [[nodiscard]] bool  reset ();
+
+    [[nodiscard]] size_t  live_count ()     const   { return _liveCount.load(); }
+    [[nodiscard]] size_t  used_bytes ()     const   { return _usedBytes.load(); }
+
+    // Allocate in arena if it is not null, otherwise allocate in heap.
+    // 'slot' is a worker index + 1 or 0 for any other thread.
+    [[nodiscard]] static void*  Allocate (FrameArena* arena, size_t size, int slot);
+    static void                 Deallocate (void* ptr);
+
+private:
+    [[nodiscard]] void*  _Allocate (size_t size, Slot &slot);
+
+    [[nodiscard]] static bool    _Register (Chunk* chunk);
+    static void                  _Unregister (Chunk* chunk);
+    [[nodiscard]] static Chunk*  _FindChunk (const void* ptr);
+    [[nodiscard]] static size_t  _Hash (uintptr_t granule);
+
+    [[nodiscard]] static size_t  _AlignUp (size_t size)     { return (size + Align-1) & ~(Align-1); }
+};
+
+
+inline FrameArena::FrameArena (size_t chunkSize) : _chunkSize{chunkSize}
+{
+    _arenaCount.fetch_add( 1 );
+}
+
+
+inline FrameArena::~FrameArena ()
+{
+    // task or dependency array outlives the arena
+    assert( _liveCount.load() == 0 );
+
+    for (auto& slot : _slots)
+    {
+        for (Chunk* c = slot.first; c != nullptr;)
+        {
+            Chunk*  next = c->next;
+
+            // memory can be reused by heap only after the chunk is removed from the table
+            _Unregister( c );
+            c->~Chunk();
+            ::operator delete( c, std::align_val_t{Granule} );
+            c = next;
+        }
+    }
+    _arenaCount.fetch_sub( 1 );
+}
+
+
+inline bool  FrameArena::reset ()
+{
+  #ifndef NDEBUG
+    _resetting.store( true );
+    assert( _allocating.load() == 0 );  // allocation is concurrent with reset
+  #endif
+
+    const bool  complete = (_liveCount.load() == 0);
+    if ( complete )
+    {
+        for (auto& slot : _slots)
+        {
+            for (Chunk* c = slot.first; c != nullptr; c = c->next) {
+                c->offset = 0;
+            }
+            slot.current = slot.first;
+        }
+        _usedBytes.store( 0 );
+    }
+
+  #ifndef NDEBUG
+    _resetting.store( false );
+  #endif
+    return complete;
+}
+
+
+inline void*  FrameArena::Allocate (FrameArena* arena, size_t size, int slot)
+{
+    if ( arena == nullptr )
+        return ::operator new( size );
+
+    assert( slot >= 0 and slot < MaxSlots );
+
+  #ifndef NDEBUG
+    arena->_allocating.fetch_add( 1 );
+    assert( not arena->_resetting.load() );  // allocation is concurrent with reset
+  #endif
+
+    void*   ptr;
+    if ( slot == 0 )
+    {
+        std::scoped_lock  lock {arena->_sharedGuard};
+        ptr = arena->_Allocate( size, arena->_slots[0] );
+    }
+    else
+        ptr = arena->_Allocate( size, arena->_slots[slot] );
+
+  #ifndef NDEBUG
+    arena->_allocating.fetch_sub( 1 );
+  #endif
+
+    // table is full, memory is not in the arena and it is not counted
+    if ( ptr == nullptr )
+        return ::operator new( size );
+
+    arena->_liveCount.fetch_add( 1 );
+    return ptr;
+}
+
+
+inline void  FrameArena::Deallocate (void* ptr)
+{
+    if ( ptr == nullptr )
+        return;
+
+    // allocation can not outlive its arena, so without arenas the memory is allocated in heap
+    if ( _arenaCount.load( std::memory_order_acquire ) > 0 )
+    {
+        if ( Chunk* c = _FindChunk( ptr ))
+        {
+            const size_t  cnt = c->arena->_liveCount.fetch_sub( 1 );
+            assert( cnt > 0 );
+            (void)(cnt);
+            return;
+        }
+    }
+    ::operator delete( ptr );
+}
+
+
+inline size_t  FrameArena::_Hash (uintptr_t granule)
+{
+    return size_t( (uint64_t(granule / Granule) * 0x9E3779B97F4A7C15ull) >> 32 ) & (TableSize - 1);
+}
+
+
+inline bool  FrameArena::_Register (Chunk* chunk)
+{
+    const auto      base    = reinterpret_cast<uintptr_t>( chunk );
+    const size_t    count   = (_AlignUp( sizeof(Chunk) ) + chunk->size) / Granule;
+
+    std::scoped_lock    lock {_tableGuard};
+
+    // keep the table half empty, so search of heap pointer ends quickly
+    if ( (_tableCount + count) * 2 > TableSize )
+        return false;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uintptr_t     granule = base + i * Granule;
+
+        for (size_t h = _Hash( granule );; h = (h + 1) & (TableSize - 1))
+        {
+            const uintptr_t     e = _table[h].load( std::memory_order_relaxed );
+            if ( e == EmptyEntry or e == RemovedEntry )
+            {
+                _table[h].store( granule + i, std::memory_order_release );
+                break;
+            }
+        }
+    }
+    _tableCount += count;
+    return true;
+}
+
+
+inline void  FrameArena::_Unregister (Chunk* chunk)
+{
+    const auto      base    = reinterpret_cast<uintptr_t>( chunk );
+    const size_t    count   = (_AlignUp( sizeof(Chunk) ) + chunk->size) / Granule;
+
+    std::scoped_lock    lock {_tableGuard};
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uintptr_t     granule = base + i * Granule;
+
+        for (size_t h = _Hash( granule );; h = (h + 1) & (TableSize - 1))
+        {
+            if ( _table[h].load( std::memory_order_relaxed ) != granule + i )
+                continue;
+
+            // entry at the end of the probe sequence and removed entries before it can be cleared
+            if ( _table[ (h + 1) & (TableSize - 1) ].load( std::memory_order_relaxed ) == EmptyEntry )
+            {
+                _table[h].store( EmptyEntry, std::memory_order_release );
+
+                for (size_t j = (h - 1) & (TableSize - 1); _table[j].load( std::memory_order_relaxed ) == RemovedEntry; j = (j - 1) & (TableSize - 1)) {
+                    _table[j].store( EmptyEntry, std::memory_order_release );
+                }
+            }
+            else
+                _table[h].store( RemovedEntry, std::memory_order_release );
+            break;
+        }
+    }
+    _tableCount -= count;
+}
+
+
+inline FrameArena::Chunk*  FrameArena::_FindChunk (const void* ptr)
+{
+    const uintptr_t     granule = reinterpret_cast<uintptr_t>( ptr ) & ~uintptr_t(Granule - 1);
+
+    for (size_t h = _Hash( granule ), i = 0; i < TableSize; h = (h + 1) & (TableSize - 1), ++i)
+    {
+        const uintptr_t     e = _table[h].load( std::memory_order_acquire );
+
+        if ( e == EmptyEntry )
+            break;
+
+        if ( e != RemovedEntry and (e & ~uintptr_t(Granule - 1)) == granule )
+            return reinterpret_cast<Chunk*>( granule - (e & (Granule - 1)) * Granule );
+    }
+    return nullptr;
+}
+
+
+inline void*  FrameArena::_Allocate (size_t size, Slot &slot)
+{
+    size = _AlignUp( size );
+
+    // find chunk with enough space, chunks after 'current' are empty after reset
+    for (; slot.current != nullptr; slot.current = slot.current->next)
+    {
+        Chunk&  c = *slot.current;
+        if ( c.offset + size <= c.size )
+        {
+            void*   ptr = c.data() + c.offset;
+            c.offset += size;
+            _usedBytes.fetch_add( size );
+            return ptr;
+        }
+        if ( c.next == nullptr )
+            break;
+    }
+
+    // allocate new chunk, large allocations use dedicated chunk
+    const size_t    header  = _AlignUp( sizeof(Chunk) );
+    const size_t    total   = (std::max( _chunkSize, header + size ) + Granule - 1) & ~(Granule - 1);
+    Chunk*          chunk   = new( ::operator new( total, std::align_val_t{Granule} )) Chunk{};
+    chunk->arena    = this;
+    chunk->size     = total - header;
+    chunk->offset   = size;
+
+    // chunk is published before memory is returned, so deallocation in another thread will find it
+    if ( not _Register( chunk ))
+    {
+        chunk->~Chunk();
+        ::operator delete( chunk, std::align_val_t{Granule} );
+        return nullptr;
+    }
+
+    if ( slot.current != nullptr )
+        slot.current->next = chunk;
+    else
+        slot.first = chunk;
+
+    slot.current = chunk;
+    _usedBytes.fetch_add( size );
+    return chunk->data();
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+#include <source_location>
+#include <cstddef>
+
+
+// Statistics of coroutine frame allocations per coroutine function.
+// Enabled by 'TASK_FRAME_PROFILER' define, then each frame has header with pointer to the function stats.
+// Function is identified by 'std::source_location' which is captured in 'promise_type::operator new'.
+struct FrameProfiler
+{
+public:
+    // Frame header must keep alignment of the frame.
+    static constexpr size_t     HeaderSize  = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    struct Site
+    {
+        std::source_location    location;
+        std::atomic<size_t>     allocations     {0};
+        std::atomic<size_t>     totalBytes      {0};
+        std::atomic<size_t>     maxFrameSize    {0};
+        std::atomic<size_t>     liveCount       {0};
+        std::atomic<size_t>     liveBytes       {0};
+        std::atomic<size_t>     peakLiveCount   {0};
+        std::atomic<size_t>     peakLiveBytes   {0};
+
+        explicit Site (const std::source_location &loc) : location{loc} {}
+    };
+
+    // Copy of site stats for report.
+    struct Entry
+    {
+        std::string     function;
+        std::string     file;
+        unsigned        line            = 0;
+        size_t          allocations     = 0;
+        size_t          totalBytes      = 0;
+        size_t          maxFrameSize    = 0;
+        size_t          liveCount       = 0;
+        size_t          peakLiveCount   = 0;
+        size_t          peakLiveBytes   = 0;
+    };
+
+private:
+    using Key_t = std::pair< const char*, unsigned >;
+
+    struct KeyHash {
+        [[nodiscard]] size_t  operator () (const Key_t &k) const    { return std::hash<const void*>{}( k.first ) ^ (size_t(k.second) << 1); }
+    };
+
+    // Sites are found without lock, the lock is taken only when site is seen the first time.
+    // Sites which do not fit into the table are stored only in '_siteMap'.
+    static constexpr size_t     TableSize   = 1024;     // power of 2
+
+    std::atomic< Site* >                            _table [TableSize] = {};
+    std::mutex                                      _guard;
+    std::deque< Site >                              _sites;     // pointers must be stable
+    std::unordered_map< Key_t, Site*, KeyHash >     _siteMap;
+
+public:
+    [[nodiscard]] static constexpr bool  IsEnabled ()
+    {
+    #ifdef TASK_FRAME_PROFILER
+        return true;
+    #else
+        return false;
+    #endif
+    }
+
+    // Returns stats of the coroutine function, 'loc' must be captured in 'operator new'.
+    [[nodiscard]] static Site*  GetSite (const std::source_location &loc);
+
+    static void  OnAllocate (Site* site, size_t size);
+    static void  OnDeallocate (Site* site, size_t size);
+
+    // Returns stats of all coroutine functions sorted by peak live bytes.
+    [[nodiscard]] static std::vector< Entry >  Report ();
+    [[nodiscard]] static std::string           ReportText (size_t maxEntries = 20);
+
+    // Reset peak values to current values.
+    static void  ResetPeak ();
+
+private:
+    [[nodiscard]] static FrameProfiler&  _Instance ()
+    {
+        static FrameProfiler    inst;
+        return inst;
+    }
+
+    static void  _UpdateMax (std::atomic<size_t> &dst, size_t value)
+    {
+        for (size_t prev = dst.load( std::memory_order_relaxed );
+             prev < value and not dst.compare_exchange_weak( prev, value, std::memory_order_relaxed );)
+        {}
+    }
+};
+
+
+inline FrameProfiler::Site*  FrameProfiler::GetSite (const std::source_location &loc)
+{
+    auto&           self    = _Instance();
+    const Key_t     key     { loc.file_name(), loc.line() };
+    const size_t    hash    = KeyHash{}( key ) * 0x9E3779B9u;
+
+    // sites are never removed, so the first empty entry means that the site is not in the table
+    const auto  Find = [&] (size_t &empty) -> Site*
+    {
+        empty = TableSize;
+        for (size_t i = 0; i < TableSize; ++i)
+        {
+            const size_t    idx     = (hash + i) & (TableSize - 1);
+            Site*           site    = self._table[idx].load( std::memory_order_acquire );
+
+            if ( site == nullptr )
+            {
+                empty = idx;
+                return nullptr;
+            }
+            if ( site->location.file_name() == key.first and site->location.line() == key.second )
+                return site;
+        }
+        return nullptr;
+    };
+
+    size_t  empty;
+    if ( Site* site = Find( empty ))
+        return site;
+
+    std::scoped_lock    lock {self._guard};
+
+    auto [it, inserted] = self._siteMap.emplace( key, nullptr );
+    if ( inserted )
+    {
+        it->second = &self._sites.emplace_back( loc );
+
+        // table is changed only under lock, so the found entry is still empty
+        if ( Find( empty ) == nullptr and empty < TableSize )
+            self._table[empty].store( it->second, std::memory_order_release );
+    }
+    return it->second;
+}
+
+
+inline void  FrameProfiler::OnAllocate (Site* site, size_t size)
+{
+    site->allocations.fetch_add( 1, std::memory_order_relaxed );
+    site->totalBytes.fetch_add( size, std::memory_order_relaxed );
+    _UpdateMax( site->maxFrameSize, size );
+
+    _UpdateMax( site->peakLiveCount, site->liveCount.fetch_add( 1, std::memory_order_relaxed ) + 1 );
+    _UpdateMax( site->peakLiveBytes, site->liveBytes.fetch_add( size, std::memory_order_relaxed ) + size );
+}
+
+
+inline void  FrameProfiler::OnDeallocate (Site* site, size_t size)
+{
+    site->liveCount.fetch_sub( 1, std::memory_order_relaxed );
+    site->liveBytes.fetch_sub( size, std::memory_order_relaxed );
+}
+
+
+inline std::vector< FrameProfiler::Entry >  FrameProfiler::Report ()
+{
+    auto&               self = _Instance();
+    std::scoped_lock    lock {self._guard};
+    std::vector<Entry>  result;
+
+    for (auto& s : self._sites)
+    {
+        auto&   e = result.emplace_back();
+        e.function      = s.location.function_name();
+        e.file          = s.location.file_name();
+        e.line          = unsigned(s.location.line());
+        e.allocations   = s.allocations.load();
+        e.totalBytes    = s.totalBytes.load();
+        e.maxFrameSize  = s.maxFrameSize.load();
+        e.liveCount     = s.liveCount.load();
+        e.peakLiveCount = s.peakLiveCount.load();
+        e.peakLiveBytes = s.peakLiveBytes.load();
+    }
+
+    std::sort( result.begin(), result.end(), [] (auto& lhs, auto& rhs) { return lhs.peakLiveBytes > rhs.peakLiveBytes; });
+    return result;
+}
+
+
+inline std::string  FrameProfiler::ReportText (size_t maxEntries)
+{
+    std::stringstream   str;
+
+    if constexpr( not IsEnabled() )
+    {
+        str << "frame profiler is disabled, define 'TASK_FRAME_PROFILER'\n";
+        return str.str();
+    }
+
+    const auto  entries = Report();
+
+    str << std::setw(10) << "peak live" << std::setw(8) << "peak #" << std::setw(8) << "frame" << std::setw(10) << "allocs" << std::setw(12) << "total" << "  function\n";
+
+    for (size_t i = 0; i < std::min( maxEntries, entries.size() ); ++i)
+    {
+        const auto&     e = entries[i];
+        str << std::setw(10) << e.peakLiveBytes << std::setw(8) << e.peakLiveCount << std::setw(8) << e.maxFrameSize
+            << std::setw(10) << e.allocations << std::setw(12) << e.totalBytes << "  " << e.function << "\n";
+    }
+    return str.str();
+}
+
+
+inline void  FrameProfiler::ResetPeak ()
+{
+    auto&               self = _Instance();
+    std::scoped_lock    lock {self._guard};
+
+    for (auto& s : self._sites)
+    {
+        s.peakLiveCount.store( s.liveCount.load() );
+        s.peakLiveBytes.store( s.liveBytes.load() );
+    }
+}
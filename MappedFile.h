@@ -0,0 +1,362 @@
+#pragma once
+
+#include "TaskSystem.h"
+#include <string_view>
+
+#if defined(__unix__) or defined(__APPLE__)
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   define MAPPED_FILE_POSIX
+#elif defined(_WIN32)
+#   include <Windows.h>
+#   define MAPPED_FILE_WINDOWS
+#else
+#   error memory mapped files are not supported on this platform
+#endif
+
+
+// Read-only memory mapped file.
+// Pages are loaded by the OS on first access, so memory is not allocated for the whole file
+// and resident memory can be reduced by 'release()'.
+struct MappedFile
+{
+private:
+    const char*     _data       = nullptr;
+    size_t          _size       = 0;
+    size_t          _pageSize   = 4096;
+    bool            _isOpen     = false;    // empty file is not mapped
+
+  #ifdef MAPPED_FILE_WINDOWS
+    HANDLE          _file       = INVALID_HANDLE_VALUE;
+    HANDLE          _mapping    = nullptr;
+  #endif
+
+public:
+    MappedFile () {}
+    explicit MappedFile (const std::string &path)   { open( path ); }
+    ~MappedFile ()                                  { close(); }
+
+    MappedFile (const MappedFile &) = delete;
+    MappedFile&  operator = (const MappedFile &) = delete;
+
+    bool  open (const std::string &path);
+    void  close ();
+
+    [[nodiscard]] bool              is_open ()  const   { return _isOpen; }
+    [[nodiscard]] const char*       data ()     const   { return _data; }
+    [[nodiscard]] size_t            size ()     const   { return _size; }
+    [[nodiscard]] std::string_view  view ()     const   { return { _data, _size }; }
+
+    // Hint: file will be read from begin to end.
+    void  advise_sequential ();
+
+    // Hint: range will be accessed soon, OS starts reading it in background.
+    void  advise_will_need (size_t offset, size_t size);
+
+    // Hint: range is not needed anymore, resident pages can be dropped and will be loaded again on access.
+    // Only pages which are entirely inside the range are released.
+    void  release (size_t offset, size_t size);
+};
+
+
+// Part of the file which ends with delimiter, or with end of the file.
+struct FileChunk
+{
+    std::string_view    data;
+    size_t              offset  = 0;
+    size_t              index   = 0;
+};
+
+
+// Synchronous generator of record-aligned chunks, chunks point to the mapped memory without copying.
+// Usage: 'for (FileChunk c : read_chunks( file, 1 << 20 )) {...}'
+struct ChunkGenerator
+{
+    struct promise_type
+    {
+        FileChunk   _current;
+
+        promise_type () {}
+
+        [[nodiscard]] ChunkGenerator        get_return_object ()    { return ChunkGenerator{ std::coroutine_handle< promise_type >::from_promise( *this )}; }
+        [[nodiscard]] std::suspend_always   initial_suspend ()      { return {}; }
+        [[nodiscard]] std::suspend_always   final_suspend () noexcept { return {}; }
+
+        std::suspend_always  yield_value (const FileChunk &chunk)
+        {
+            _current = chunk;
+            return {};
+        }
+
+        void  return_void () {}
+        void  unhandled_exception ()    { throw; }
+    };
+
+    struct Sentinel {};
+
+    struct Iterator
+    {
+        std::coroutine_handle< promise_type >   _handle;
+
+        [[nodiscard]] const FileChunk&  operator * ()   const   { return _handle.promise()._current; }
+        Iterator&                       operator ++ ()          { _handle.resume();  return *this; }
+        [[nodiscard]] bool              operator == (Sentinel) const { return _handle.done(); }
+    };
+
+private:
+    std::coroutine_handle< promise_type >   _handle;
+
+public:
+    explicit ChunkGenerator (std::coroutine_handle< promise_type > h) : _handle{h} {}
+    ChunkGenerator (ChunkGenerator && other) : _handle{ std::exchange( other._handle, nullptr )} {}
+    ~ChunkGenerator ()                                          { if ( _handle ) _handle.destroy(); }
+
+    ChunkGenerator (const ChunkGenerator &) = delete;
+    ChunkGenerator&  operator = (const ChunkGenerator &) = delete;
+
+    [[nodiscard]] Iterator  begin ()
+    {
+        _handle.resume();
+        return Iterator{ _handle };
+    }
+    [[nodiscard]] Sentinel  end ()      { return {}; }
+};
+
+
+// Splits mapped file into chunks of approximately 'chunkSize' bytes, each chunk is extended to the next 'delimiter'.
+// Next 'readAhead' chunks are requested from the OS while the current chunk is processed.
+[[nodiscard]] inline ChunkGenerator  read_chunks (MappedFile &file, size_t chunkSize, char delimiter = '\n', size_t readAhead = 4)
+{
+    assert( file.is_open() );
+    assert( chunkSize > 0 );
+
+    const std::string_view  all         = file.view();
+    size_t                  prefetched  = 0;    // end of the range which is requested from the OS
+
+    file.advise_sequential();
+
+    for (size_t offset = 0, index = 0; offset < all.size(); ++index)
+    {
+        // approximate end of the read-ahead window, chunks are usually slightly larger
+        const size_t    ahead = std::min( all.size(), offset + chunkSize * (readAhead + 1) );
+        if ( ahead > prefetched )
+        {
+            file.advise_will_need( std::max( offset, prefetched ), ahead - std::max( offset, prefetched ));
+            prefetched = ahead;
+        }
+
+        size_t  end = std::min( all.size(), offset + chunkSize );
+        if ( end < all.size() )
+        {
+            const size_t    pos = all.find( delimiter, end - 1 );
+            end = (pos == std::string_view::npos ? all.size() : pos + 1);
+        }
+
+        co_yield FileChunk{ all.substr( offset, end - offset ), offset, index };
+        offset = end;
+    }
+}
+
+
+// Process chunks in parallel on the current task system, 'fn' returns 'Task<T>' for each chunk.
+// At most 'maxInFlight' chunks are processed at the same time, pages of the processed chunks are released,
+// so resident memory is bounded by 'maxInFlight' and read-ahead window instead of file size.
+// Results of chunk tasks are ignored, exceptions are rethrown.
+template <typename Fn>
+[[nodiscard]] Task<>  for_each_chunk (MappedFile &file, ChunkGenerator chunks, Fn fn, size_t maxInFlight)
+{
+    using Task_t = std::invoke_result_t< Fn, const FileChunk& >;
+
+    assert( maxInFlight > 0 );
+
+    struct InFlight
+    {
+        Task_t      task;
+        FileChunk   chunk;
+    };
+    std::deque< InFlight >  inFlight;
+
+    for (const FileChunk& chunk : chunks)
+    {
+        // wait for the oldest chunk, chunks are completed approximately in order
+        if ( inFlight.size() >= maxInFlight )
+        {
+            co_await inFlight.front().task;
+            file.release( inFlight.front().chunk.offset, inFlight.front().chunk.data.size() );
+            inFlight.pop_front();
+        }
+
+        auto&   item = inFlight.emplace_back( InFlight{ fn( chunk ), chunk });
+        TaskSystem::current()->add( item.task );
+    }
+
+    for (; not inFlight.empty(); inFlight.pop_front())
+    {
+        co_await inFlight.front().task;
+        file.release( inFlight.front().chunk.offset, inFlight.front().chunk.data.size() );
+    }
+}
+
+
+#ifdef MAPPED_FILE_POSIX
+
+inline bool  MappedFile::open (const std::string &path)
+{
+    close();
+
+    const int   fd = ::open( path.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        return false;
+
+    struct stat     st;
+    if ( ::fstat( fd, &st ) != 0 )
+    {
+        ::close( fd );
+        return false;
+    }
+
+    _pageSize   = size_t(::sysconf( _SC_PAGESIZE ));
+    _size       = size_t(st.st_size);
+
+    if ( _size > 0 )
+    {
+        void*   ptr = ::mmap( nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( ptr == MAP_FAILED )
+        {
+            _size = 0;
+            ::close( fd );
+            return false;
+        }
+        _data = static_cast< const char* >( ptr );
+    }
+
+    // mapping keeps the file alive
+    ::close( fd );
+    _isOpen = true;
+    return true;
+}
+
+inline void  MappedFile::close ()
+{
+    if ( _data != nullptr )
+        ::munmap( const_cast< char* >( _data ), _size );
+
+    _data   = nullptr;
+    _size   = 0;
+    _isOpen = false;
+}
+
+inline void  MappedFile::advise_sequential ()
+{
+    if ( _data != nullptr )
+        ::madvise( const_cast< char* >( _data ), _size, MADV_SEQUENTIAL );
+}
+
+inline void  MappedFile::advise_will_need (size_t offset, size_t size)
+{
+    if ( _data == nullptr or offset >= _size or size == 0 )
+        return;
+
+    // address must be aligned to page size
+    const size_t    begin   = offset & ~(_pageSize - 1);
+    const size_t    end     = std::min( _size, offset + size );
+
+    ::madvise( const_cast< char* >( _data + begin ), end - begin, MADV_WILLNEED );
+}
+
+inline void  MappedFile::release (size_t offset, size_t size)
+{
+    if ( _data == nullptr or offset >= _size )
+        return;
+
+    // pages on the boundary may be used by neighbour chunks
+    const size_t    begin   = (offset + _pageSize - 1) & ~(_pageSize - 1);
+    const size_t    end     = std::min( _size, offset + size ) & ~(_pageSize - 1);
+
+    if ( begin < end )
+        ::madvise( const_cast< char* >( _data + begin ), end - begin, MADV_DONTNEED );
+}
+
+#endif // MAPPED_FILE_POSIX
+
+
+#ifdef MAPPED_FILE_WINDOWS
+
+inline bool  MappedFile::open (const std::string &path)
+{
+    close();
+
+    _file = ::CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if ( _file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER   size;
+    if ( not ::GetFileSizeEx( _file, &size ))
+    {
+        close();
+        return false;
+    }
+
+    SYSTEM_INFO     info;
+    ::GetSystemInfo( &info );
+    _pageSize   = size_t(info.dwPageSize);
+    _size       = size_t(size.QuadPart);
+
+    if ( _size > 0 )
+    {
+        _mapping = ::CreateFileMappingA( _file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        if ( _mapping != nullptr )
+            _data = static_cast< const char* >( ::MapViewOfFile( _mapping, FILE_MAP_READ, 0, 0, 0 ));
+
+        if ( _data == nullptr )
+        {
+            close();
+            return false;
+        }
+    }
+    _isOpen = true;
+    return true;
+}
+
+inline void  MappedFile::close ()
+{
+    if ( _data != nullptr )
+        ::UnmapViewOfFile( _data );
+    if ( _mapping != nullptr )
+        ::CloseHandle( _mapping );
+    if ( _file != INVALID_HANDLE_VALUE )
+        ::CloseHandle( _file );
+
+    _data       = nullptr;
+    _mapping    = nullptr;
+    _file       = INVALID_HANDLE_VALUE;
+    _size       = 0;
+    _isOpen     = false;
+}
+
+// sequential access is requested by 'FILE_FLAG_SEQUENTIAL_SCAN'
+inline void  MappedFile::advise_sequential () {}
+
+inline void  MappedFile::advise_will_need (size_t offset, size_t size)
+{
+    if ( _data == nullptr or offset >= _size or size == 0 )
+        return;
+
+    WIN32_MEMORY_RANGE_ENTRY    range;
+    range.VirtualAddress    = const_cast< char* >( _data + offset );
+    range.NumberOfBytes     = std::min( _size - offset, size );
+    ::PrefetchVirtualMemory( ::GetCurrentProcess(), 1, &range, 0 );
+}
+
+inline void  MappedFile::release (size_t offset, size_t size)
+{
+    if ( _data == nullptr or offset >= _size )
+        return;
+
+    // removes pages from the working set, they stay in the file cache
+    ::VirtualUnlock( const_cast< char* >( _data + offset ), std::min( _size - offset, size ));
+}
+
+#endif // MAPPED_FILE_WINDOWS
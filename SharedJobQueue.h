@@ -0,0 +1,772 @@
+#pragma once
+
+#include "TaskSystem.h"
+#include <unordered_map>
+#include <cstring>
+
+#if defined(__unix__) or defined(__APPLE__)
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <signal.h>
+#   include <cerrno>
+#   define SHARED_JOB_QUEUE_SUPPORTED
+#endif
+
+#ifdef SHARED_JOB_QUEUE_SUPPORTED
+
+// Job queue in POSIX shared memory, connects task systems in different processes on the same host.
+//
+// Each process has its own lock-free ring in the shared segment, submitted jobs are added to the own ring.
+// 'poll()' takes jobs from the own ring and, when it is empty, steals jobs from rings of other processes,
+// so idle processes help busy ones. Each job is executed as a task on the local task system.
+//
+// Job is a descriptor (type + payload offset), payload is written to the shared segment by producer
+// and read in place by consumer, it is never copied between processes.
+//
+// Process is dead only when it does not exist anymore, then jobs which are claimed by the dead process are added back
+// to the queue and its slot can be used by a new process. Process which is alive but stalled keeps its slot and jobs,
+// so two processes never use the same slot. Job can be executed more than once if the process is killed after
+// the handler has finished, job handlers must be idempotent.
+// Job is claimed before it is removed from the ring, so it is not lost if the process is killed in between.
+struct SharedJobQueue
+{
+public:
+    static constexpr uint32_t   MaxProcesses    = 32;
+
+    struct Params
+    {
+        uint32_t                    jobCapacity         = 1024;     // max number of jobs in all states
+        uint32_t                    payloadSize         = 256;      // max payload size of a single job
+        std::chrono::milliseconds   openTimeout         {2000};     // time to wait until the creator initializes the segment
+    };
+
+    struct JobView
+    {
+        uint32_t        type    = 0;
+        uint64_t        offset  = 0;    // offset of payload from the begin of the shared segment
+        uint32_t        size    = 0;
+        const void*     data    = nullptr;
+    };
+
+    // Job which is allocated for writing payload, must be passed to 'submit()'.
+    struct JobHandle
+    {
+        uint32_t        index   = UMax;
+        void*           data    = nullptr;
+        uint32_t        capacity= 0;
+
+        [[nodiscard]] explicit operator bool () const   { return index != UMax; }
+    };
+
+    struct Stats
+    {
+        size_t  submitted   = 0;
+        size_t  executed    = 0;
+        size_t  stolen      = 0;    // jobs which are taken from rings of other processes
+        size_t  reclaimed   = 0;    // jobs which are taken back from dead processes
+        size_t  deadPeers   = 0;
+        size_t  dropped     = 0;    // jobs with unknown type or invalid size
+        size_t  failed      = 0;    // jobs which handler has thrown exception
+    };
+
+    using Handler_t = std::function< void (const JobView &) >;
+
+private:
+    static constexpr uint32_t   UMax        = ~0u;
+    static constexpr uint64_t   Magic       = 0x4A6F6251'75657565ull;
+    static constexpr size_t     CacheLine   = 64;
+
+    enum class JobState : uint64_t
+    {
+        Free,
+        Allocated,      // payload is written by the owner
+        Ready,          // job is in one of the rings
+        Claimed,        // job is executed by the owner
+    };
+
+    // Single word, so state and owner are changed by a single CAS.
+    // Generation protects from ABA when job is reused.
+    struct JobWord
+    {
+        static constexpr uint64_t  Make (JobState state, uint32_t owner, uint64_t gen)  { return uint64_t(state) | (uint64_t(owner & 0xFF) << 8) | (gen << 16); }
+        static constexpr JobState  State (uint64_t w)                                   { return JobState(w & 0xFF); }
+        static constexpr uint32_t  Owner (uint64_t w)                                   { return uint32_t(w >> 8) & 0xFF; }
+        static constexpr uint64_t  Gen (uint64_t w)                                     { return w >> 16; }
+    };
+
+    struct alignas(CacheLine) Header
+    {
+        std::atomic<uint64_t>   initialized     {0};
+        uint32_t                jobCapacity     = 0;
+        uint32_t                ringCapacity    = 0;    // power of 2, not less than twice the job capacity
+        uint32_t                payloadSize     = 0;
+        uint64_t                jobsOffset      = 0;
+        uint64_t                ringsOffset     = 0;
+        uint64_t                payloadOffset   = 0;
+
+        // Stack of free jobs: low 32 bits - index + 1, high 32 bits - tag.
+        alignas(CacheLine) std::atomic<uint64_t>    freeHead    {0};
+    };
+
+    struct alignas(CacheLine) ProcessSlot
+    {
+        std::atomic<int32_t>    pid         {0};    // 0 - free slot, -1 - dead process is reclaimed
+    };
+
+    struct Job
+    {
+        std::atomic<uint64_t>   word        {0};
+        uint32_t                type        = 0;
+        uint32_t                size        = 0;
+        uint32_t                nextFree    = 0;    // index + 1
+    };
+
+    struct Cell
+    {
+        std::atomic<uint64_t>   seq         {0};
+        std::atomic<uint32_t>   job         {0};    // read before the cell is removed, so it is atomic
+    };
+
+    // Bounded MPMC ring by D. Vyukov, followed by 'ringCapacity' cells.
+    struct alignas(CacheLine) Ring
+    {
+        alignas(CacheLine) std::atomic<uint64_t>    enqueuePos  {0};
+        alignas(CacheLine) std::atomic<uint64_t>    dequeuePos  {0};
+    };
+
+    static_assert( std::atomic<uint64_t>::is_always_lock_free );
+    static_assert( std::atomic<int64_t>::is_always_lock_free );
+    static_assert( std::atomic<int32_t>::is_always_lock_free );
+
+private:
+    std::string             _name;
+    char*                   _base       = nullptr;
+    size_t                  _size       = 0;
+    Header*                 _header     = nullptr;
+    ProcessSlot*            _slots      = nullptr;
+    uint32_t                _self       = UMax;     // index of process slot
+    Params                  _params;
+
+    std::mutex                                      _handlersGuard;
+    std::unordered_map< uint32_t, Handler_t >       _handlers;
+
+    std::atomic<size_t>     _inFlight   {0};        // jobs which are added to the local task system
+
+    std::atomic<size_t>     _statSubmitted  {0};
+    std::atomic<size_t>     _statExecuted   {0};
+    std::atomic<size_t>     _statStolen     {0};
+    std::atomic<size_t>     _statReclaimed  {0};
+    std::atomic<size_t>     _statDeadPeers  {0};
+    std::atomic<size_t>     _statDropped    {0};
+    std::atomic<size_t>     _statFailed     {0};
+
+public:
+    SharedJobQueue () {}
+    ~SharedJobQueue ()                                          { close(); }
+
+    SharedJobQueue (const SharedJobQueue &) = delete;
+    SharedJobQueue&  operator = (const SharedJobQueue &) = delete;
+
+    // Create shared segment or attach to existing one, all processes must use the same params.
+    // Returns 'false' if the segment is not initialized during 'openTimeout' or it was created with other params.
+    // Name must start with '/', see 'shm_open()'.
+    bool  open (const std::string &name, const Params &params);
+    bool  open (const std::string &name)                        { return open( name, Params{} ); }
+
+    // Detach from shared segment, all jobs must be completed.
+    void  close ();
+
+    // Remove shared segment name, segment is destroyed when the last process is detached.
+    static void  unlink (const std::string &name)               { ::shm_unlink( name.c_str() ); }
+
+    [[nodiscard]] bool  is_open ()  const                       { return _base != nullptr; }
+    [[nodiscard]] Stats stats ()    const;
+
+    // Handler is executed on the local task system.
+    // If the handler throws, the job is completed and is not executed again, exception is stored in the task.
+    void  set_handler (uint32_t type, Handler_t fn);
+
+    // Allocate job and write payload directly to shared memory, then call 'submit()'.
+    // Returns invalid handle if all jobs are used.
+    [[nodiscard]] JobHandle  allocate ();
+    void  submit (const JobHandle &job, uint32_t type, uint32_t size);
+
+    // Allocate, copy payload and submit, returns 'false' if all jobs are used.
+    bool  submit (uint32_t type, const void* data, uint32_t size);
+
+    // Reclaim jobs of dead processes and add jobs to the task system
+    // while number of local jobs in progress is less than 'maxInFlight'.
+    // Returns number of jobs which are added to the task system.
+    size_t  poll (TaskSystem &ts, size_t maxInFlight);
+
+    // Returns number of jobs which are added back to the queue.
+    size_t  reclaim_dead_peers ();
+
+    // Low level API.
+    // Claimed job must be passed to 'complete()', if process crashes before that, job will be reclaimed.
+    [[nodiscard]] bool  try_claim (uint32_t &job, uint64_t &word);
+    [[nodiscard]] JobView  job_view (uint32_t job) const;
+    void  complete (uint32_t job, uint64_t word);
+
+private:
+    [[nodiscard]] Job*   job_at (uint32_t index)  const     { return reinterpret_cast< Job* >( _base + _header->jobsOffset ) + index; }
+    [[nodiscard]] Ring*  ring_at (uint32_t slot)  const     { return reinterpret_cast< Ring* >( _base + _header->ringsOffset + slot * ring_stride() ); }
+    [[nodiscard]] Cell*  cells (Ring* ring)       const     { return reinterpret_cast< Cell* >( ring + 1 ); }
+    [[nodiscard]] size_t ring_stride ()           const     { return sizeof(Ring) + AlignUp( sizeof(Cell) * _header->ringCapacity, CacheLine ); }
+
+    [[nodiscard]] static size_t  AlignUp (size_t value, size_t align)   { return (value + align - 1) & ~(align - 1); }
+
+    void  init_segment ();
+    [[nodiscard]] bool  attach_slot ();
+
+    void  push_free (uint32_t index);
+    [[nodiscard]] uint32_t  pop_free ();
+
+    bool  ring_push (uint32_t slot, uint32_t job);
+    [[nodiscard]] bool  ring_claim (uint32_t slot, uint32_t &job, uint64_t &word);
+
+    [[nodiscard]] bool  is_dead (uint32_t slot) const;
+};
+
+
+inline bool  SharedJobQueue::open (const std::string &name, const Params &params)
+{
+    close();
+    assert( params.jobCapacity > 0 and params.payloadSize > 0 );
+
+    _params = params;
+
+    // ring may also contain stale entries of jobs which were claimed by a killed process and reclaimed
+    uint32_t    ringCapacity = 1;
+    for (; ringCapacity < params.jobCapacity * 2; ringCapacity <<= 1) {}
+
+    // layout: header, process slots, jobs, rings, payload
+    const size_t    slotsOffset     = AlignUp( sizeof(Header), CacheLine );
+    const size_t    jobsOffset      = AlignUp( slotsOffset + sizeof(ProcessSlot) * MaxProcesses, CacheLine );
+    const size_t    ringsOffset     = AlignUp( jobsOffset + sizeof(Job) * params.jobCapacity, CacheLine );
+    const size_t    ringStride      = sizeof(Ring) + AlignUp( sizeof(Cell) * ringCapacity, CacheLine );
+    const size_t    payloadOffset   = AlignUp( ringsOffset + ringStride * MaxProcesses, CacheLine );
+    const size_t    size            = payloadOffset + size_t(params.payloadSize) * params.jobCapacity;
+
+    bool    created = true;
+    int     fd      = ::shm_open( name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600 );
+
+    if ( fd < 0 and errno == EEXIST )
+    {
+        created = false;
+        fd      = ::shm_open( name.c_str(), O_RDWR, 0600 );
+    }
+    if ( fd < 0 )
+        return false;
+
+    if ( created )
+    {
+        if ( ::ftruncate( fd, off_t(size) ) != 0 )
+        {
+            ::close( fd );
+            ::shm_unlink( name.c_str() );
+            return false;
+        }
+    }
+    else
+    {
+        // wait until creator sets the size, size depends on params
+        struct stat     st  {};
+        const auto      end = std::chrono::steady_clock::now() + params.openTimeout;
+
+        for (; ::fstat( fd, &st ) == 0 and st.st_size == 0 and std::chrono::steady_clock::now() < end;) {
+            std::this_thread::yield();
+        }
+        if ( size_t(st.st_size) != size )
+        {
+            ::close( fd );
+            return false;
+        }
+    }
+
+    void*   ptr = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+
+    if ( ptr == MAP_FAILED )
+        return false;
+
+    _name   = name;
+    _base   = static_cast< char* >( ptr );
+    _size   = size;
+    _header = reinterpret_cast< Header* >( _base );
+    _slots  = reinterpret_cast< ProcessSlot* >( _base + slotsOffset );
+
+    if ( created )
+    {
+        // memory is zeroed by 'ftruncate()', atomics are lock-free, so zero is a valid initial state
+        _header->jobCapacity    = params.jobCapacity;
+        _header->ringCapacity   = ringCapacity;
+        _header->payloadSize    = params.payloadSize;
+        _header->jobsOffset     = jobsOffset;
+        _header->ringsOffset    = ringsOffset;
+        _header->payloadOffset  = payloadOffset;
+
+        init_segment();
+        _header->initialized.store( Magic, std::memory_order_release );
+    }
+    else
+    {
+        const auto  end = std::chrono::steady_clock::now() + params.openTimeout;
+        for (; _header->initialized.load( std::memory_order_acquire ) != Magic and std::chrono::steady_clock::now() < end;) {
+            std::this_thread::yield();
+        }
+
+        // creator has crashed or used other params
+        if ( _header->initialized.load( std::memory_order_acquire ) != Magic or
+             _header->jobCapacity   != params.jobCapacity   or
+             _header->ringCapacity  != ringCapacity         or
+             _header->payloadSize   != params.payloadSize   or
+             _header->jobsOffset    != jobsOffset           or
+             _header->ringsOffset   != ringsOffset          or
+             _header->payloadOffset != payloadOffset )
+        {
+            close();
+            return false;
+        }
+    }
+
+    if ( not attach_slot() )
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+inline void  SharedJobQueue::close ()
+{
+    if ( _base == nullptr )
+        return;
+
+    assert( _inFlight.load() == 0 );
+
+    // jobs in the own ring stay in the queue and can be stolen
+    if ( _self != UMax )
+        _slots[_self].pid.store( 0 );
+
+    ::munmap( _base, _size );
+
+    _base   = nullptr;
+    _size   = 0;
+    _header = nullptr;
+    _slots  = nullptr;
+    _self   = UMax;
+}
+
+
+inline void  SharedJobQueue::init_segment ()
+{
+    for (uint32_t s = 0; s < MaxProcesses; ++s)
+    {
+        Cell*   c = cells( ring_at( s ));
+        for (uint32_t i = 0; i < _header->ringCapacity; ++i) {
+            c[i].seq.store( i, std::memory_order_relaxed );
+        }
+    }
+
+    for (uint32_t i = _header->jobCapacity; i-- > 0;) {
+        push_free( i );
+    }
+}
+
+
+inline bool  SharedJobQueue::attach_slot ()
+{
+    const int32_t   pid = int32_t(::getpid());
+
+    for (uint32_t s = 0; s < MaxProcesses; ++s)
+    {
+        int32_t     expected = 0;
+        if ( _slots[s].pid.load() != expected )
+            continue;
+
+        if ( _slots[s].pid.compare_exchange_strong( expected, pid ))
+        {
+            _self = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+inline void  SharedJobQueue::set_handler (uint32_t type, Handler_t fn)
+{
+    std::scoped_lock    lock {_handlersGuard};
+    _handlers[type] = std::move(fn);
+}
+
+
+inline SharedJobQueue::Stats  SharedJobQueue::stats () const
+{
+    Stats   result;
+    result.submitted    = _statSubmitted.load( std::memory_order_relaxed );
+    result.executed     = _statExecuted.load( std::memory_order_relaxed );
+    result.stolen       = _statStolen.load( std::memory_order_relaxed );
+    result.reclaimed    = _statReclaimed.load( std::memory_order_relaxed );
+    result.deadPeers    = _statDeadPeers.load( std::memory_order_relaxed );
+    result.dropped      = _statDropped.load( std::memory_order_relaxed );
+    result.failed       = _statFailed.load( std::memory_order_relaxed );
+    return result;
+}
+
+
+inline void  SharedJobQueue::push_free (uint32_t index)
+{
+    Job*        job     = job_at( index );
+    uint64_t    head    = _header->freeHead.load();
+
+    for (;;)
+    {
+        job->nextFree = uint32_t(head);
+
+        const uint64_t  tag = (head >> 32) + 1;
+        if ( _header->freeHead.compare_exchange_weak( head, (tag << 32) | (index + 1) ))
+            return;
+    }
+}
+
+
+inline uint32_t  SharedJobQueue::pop_free ()
+{
+    uint64_t    head = _header->freeHead.load();
+
+    for (;;)
+    {
+        const uint32_t  top = uint32_t(head);
+        if ( top == 0 )
+            return UMax;
+
+        // 'nextFree' may be changed by another process, then tag is changed too and CAS fails
+        const uint64_t  next    = job_at( top - 1 )->nextFree;
+        const uint64_t  tag     = (head >> 32) + 1;
+
+        if ( _header->freeHead.compare_exchange_weak( head, (tag << 32) | next ))
+            return top - 1;
+    }
+}
+
+
+inline bool  SharedJobQueue::ring_push (uint32_t slot, uint32_t job)
+{
+    Ring*           ring    = ring_at( slot );
+    Cell*           c       = cells( ring );
+    const uint64_t  mask    = _header->ringCapacity - 1;
+    uint64_t        pos     = ring->enqueuePos.load( std::memory_order_relaxed );
+    Cell*           cell;
+
+    for (;;)
+    {
+        cell = &c[ pos & mask ];
+        const int64_t   dif = int64_t(cell->seq.load( std::memory_order_acquire )) - int64_t(pos);
+
+        if ( dif == 0 )
+        {
+            if ( ring->enqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ))
+                break;
+        }
+        else
+        if ( dif < 0 )
+            return false;  // full
+        else
+            pos = ring->enqueuePos.load( std::memory_order_relaxed );
+    }
+
+    cell->job.store( job, std::memory_order_relaxed );
+    cell->seq.store( pos + 1, std::memory_order_release );
+    return true;
+}
+
+
+// Claim the front job of the ring and then remove it from the ring.
+// If the process is killed in between, the claimed job is reclaimed and the stale entry is skipped by another process.
+// Entry of the job which is claimed by another process or reclaimed and added to another ring is removed and skipped.
+inline bool  SharedJobQueue::ring_claim (uint32_t slot, uint32_t &index, uint64_t &word)
+{
+    Ring*           ring    = ring_at( slot );
+    Cell*           c       = cells( ring );
+    const uint64_t  mask    = _header->ringCapacity - 1;
+    uint64_t        pos     = ring->dequeuePos.load( std::memory_order_relaxed );
+
+    for (;;)
+    {
+        Cell&           cell    = c[ pos & mask ];
+        const int64_t   dif     = int64_t(cell.seq.load( std::memory_order_acquire )) - int64_t(pos + 1);
+
+        if ( dif < 0 )
+            return false;  // empty
+
+        if ( dif > 0 )
+        {
+            pos = ring->dequeuePos.load( std::memory_order_relaxed );
+            continue;
+        }
+
+        const uint32_t  job     = cell.job.load( std::memory_order_relaxed );
+        Job*            j       = job_at( job );
+        uint64_t        w       = j->word.load( std::memory_order_acquire );
+        bool            claimed = false;
+
+        // cell is not reused while sequence is the same, so 'job' is valid
+        if ( JobWord::State( w ) == JobState::Ready and cell.seq.load( std::memory_order_acquire ) == pos + 1 )
+        {
+            const uint64_t  cw = JobWord::Make( JobState::Claimed, _self, JobWord::Gen( w ) + 1 );
+            if ( j->word.compare_exchange_strong( w, cw, std::memory_order_acq_rel ))
+            {
+                claimed = true;
+                index   = job;
+                word    = cw;
+            }
+        }
+
+        // fails if the entry is removed by another process
+        uint64_t    expected = pos;
+        if ( ring->dequeuePos.compare_exchange_strong( expected, pos + 1, std::memory_order_relaxed ))
+        {
+            cell.seq.store( pos + mask + 1, std::memory_order_release );
+            ++pos;
+        }
+        else
+            pos = expected;
+
+        if ( claimed )
+            return true;
+    }
+}
+
+
+inline SharedJobQueue::JobHandle  SharedJobQueue::allocate ()
+{
+    assert( _self != UMax );
+
+    const uint32_t  index = pop_free();
+    if ( index == UMax )
+        return {};
+
+    Job*        job     = job_at( index );
+    uint64_t    word    = job->word.load();
+
+    // only the owner of the free job can change it
+    assert( JobWord::State( word ) == JobState::Free );
+    job->word.store( JobWord::Make( JobState::Allocated, _self, JobWord::Gen( word ) + 1 ));
+
+    JobHandle   result;
+    result.index    = index;
+    result.data     = _base + _header->payloadOffset + size_t(index) * _header->payloadSize;
+    result.capacity = _header->payloadSize;
+    return result;
+}
+
+
+inline void  SharedJobQueue::submit (const JobHandle &handle, uint32_t type, uint32_t size)
+{
+    assert( handle );
+    assert( size <= _header->payloadSize );
+
+    Job*    job = job_at( handle.index );
+    job->type   = type;
+    job->size   = size;
+
+    // payload and descriptor are visible to other processes after this store
+    const uint64_t  word = job->word.load();
+    assert( JobWord::State( word ) == JobState::Allocated and JobWord::Owner( word ) == _self );
+    job->word.store( JobWord::Make( JobState::Ready, _self, JobWord::Gen( word )), std::memory_order_release );
+
+    // ring capacity is greater than number of jobs
+    const bool  ok = ring_push( _self, handle.index );
+    assert( ok );  (void)(ok);
+
+    _statSubmitted.fetch_add( 1, std::memory_order_relaxed );
+}
+
+
+inline bool  SharedJobQueue::submit (uint32_t type, const void* data, uint32_t size)
+{
+    JobHandle   job = allocate();
+    if ( not job )
+        return false;
+
+    std::memcpy( job.data, data, size );
+    submit( job, type, size );
+    return true;
+}
+
+
+inline bool  SharedJobQueue::try_claim (uint32_t &index, uint64_t &word)
+{
+    assert( _self != UMax );
+
+    // own ring first, then steal from other processes
+    for (uint32_t i = 0; i < MaxProcesses; ++i)
+    {
+        const uint32_t  slot = (_self + i) % MaxProcesses;
+
+        if ( ring_claim( slot, index, word ))
+        {
+            if ( slot != _self )
+                _statStolen.fetch_add( 1, std::memory_order_relaxed );
+            return true;
+        }
+    }
+    return false;
+}
+
+
+inline SharedJobQueue::JobView  SharedJobQueue::job_view (uint32_t index) const
+{
+    const Job*  job = job_at( index );
+
+    JobView     result;
+    result.type     = job->type;
+    result.size     = job->size;
+    result.offset   = _header->payloadOffset + size_t(index) * _header->payloadSize;
+    result.data     = _base + result.offset;
+    return result;
+}
+
+
+inline void  SharedJobQueue::complete (uint32_t index, uint64_t word)
+{
+    Job*    job = job_at( index );
+
+    // CAS fails if the job is reclaimed, it happens only if this process was considered dead
+    if ( job->word.compare_exchange_strong( word, JobWord::Make( JobState::Free, _self, JobWord::Gen( word ))))
+        push_free( index );
+}
+
+
+// Only a process which does not exist is dead, stalled process may continue to claim jobs with its slot index.
+inline bool  SharedJobQueue::is_dead (uint32_t slot) const
+{
+    const int32_t   pid = _slots[slot].pid.load();
+    if ( pid <= 0 or slot == _self )
+        return false;
+
+    return ::kill( pid, 0 ) != 0 and errno == ESRCH;
+}
+
+
+inline size_t  SharedJobQueue::reclaim_dead_peers ()
+{
+    assert( _self != UMax );
+
+    size_t  count = 0;
+
+    for (uint32_t s = 0; s < MaxProcesses; ++s)
+    {
+        if ( not is_dead( s ))
+            continue;
+
+        // only one process reclaims jobs of the dead process
+        int32_t     pid = _slots[s].pid.load();
+        if ( pid <= 0 or not _slots[s].pid.compare_exchange_strong( pid, -1 ))
+            continue;
+
+        _statDeadPeers.fetch_add( 1, std::memory_order_relaxed );
+
+        for (uint32_t i = 0; i < _header->jobCapacity; ++i)
+        {
+            Job*        job = job_at( i );
+            uint64_t    w   = job->word.load( std::memory_order_acquire );
+
+            if ( JobWord::Owner( w ) != s )
+                continue;
+
+            switch ( JobWord::State( w ))
+            {
+                // payload is not complete
+                case JobState::Allocated :
+                    if ( job->word.compare_exchange_strong( w, JobWord::Make( JobState::Free, _self, JobWord::Gen( w ))))
+                        push_free( i );
+                    break;
+
+                case JobState::Claimed :
+                    if ( job->word.compare_exchange_strong( w, JobWord::Make( JobState::Ready, _self, JobWord::Gen( w ) + 1 ), std::memory_order_acq_rel ))
+                    {
+                        const bool  ok = ring_push( _self, i );
+                        assert( ok );  (void)(ok);
+                        ++count;
+                    }
+                    break;
+
+                // jobs in the ring of the dead process are stolen by 'try_claim()'
+                case JobState::Free :
+                case JobState::Ready :
+                    break;
+            }
+        }
+
+        // slot can be used by a new process, ring of the slot still contains jobs
+        _slots[s].pid.store( 0 );
+    }
+
+    _statReclaimed.fetch_add( count, std::memory_order_relaxed );
+    return count;
+}
+
+
+inline size_t  SharedJobQueue::poll (TaskSystem &ts, size_t maxInFlight)
+{
+    reclaim_dead_peers();
+
+    size_t  added = 0;
+    for (uint32_t index; _inFlight.load() < maxInFlight;)
+    {
+        uint64_t    word;
+        if ( not try_claim( index, word ))
+            break;
+
+        // descriptor is written by another process, so type and size are not trusted
+        const JobView   view = job_view( index );
+        Handler_t       fn;
+
+        if ( view.size <= _header->payloadSize )
+        {
+            std::scoped_lock    lock {_handlersGuard};
+            if ( auto it = _handlers.find( view.type );  it != _handlers.end() )
+                fn = it->second;
+        }
+
+        // invalid job is released, so it does not stay claimed
+        if ( not fn )
+        {
+            complete( index, word );
+            _statDropped.fetch_add( 1, std::memory_order_relaxed );
+            continue;
+        }
+
+        _inFlight.fetch_add( 1 );
+        ++added;
+
+        ts.add( [this, index, word, view, fn = std::move(fn)] ()
+                {
+                    // job is completed even if the handler throws, otherwise it stays claimed by the live process
+                    const auto  Finish = [&] (std::atomic<size_t> &stat)
+                    {
+                        complete( index, word );
+                        stat.fetch_add( 1, std::memory_order_relaxed );
+                        _inFlight.fetch_sub( 1 );
+                    };
+
+                    try {
+                        fn( view );
+                    }
+                    catch (...) {
+                        Finish( _statFailed );
+                        throw;
+                    }
+                    Finish( _statExecuted );
+                });
+    }
+    return added;
+}
+
+#endif // SHARED_JOB_QUEUE_SUPPORTED
@@ -0,0 +1,268 @@
+#pragma once
+
+#include "TaskSystem.h"
+
+
+// Pipeline which shape is known at compile time.
+// 'pipeline< A, B, join< C, D >, E >' executes A, then B, then C and D in parallel, then E.
+// Elements: stage type with 'void operator () ()', 'join<...>' of parallel elements, 'seq<...>' of sequential elements.
+// Stages must not throw exceptions.
+// Stages are stored in a single object, dependency counts and edges are computed at compile time,
+// each run does not allocate memory. Each stage is executed by the task system as a separate task.
+template <typename ...Elements>
+struct seq {};
+
+template <typename ...Elements>
+struct join {};
+
+
+namespace _hidden_
+{
+    template <typename ...Types>
+    struct TypeList
+    {
+        static constexpr size_t     Count   = sizeof...(Types);
+
+        template <typename ...Other>
+        static TypeList< Types..., Other... >  Append (TypeList< Other... >);
+    };
+
+    // Flat list of stages in order of declaration.
+    template <typename E>
+    struct StageList {
+        using type = TypeList< E >;
+    };
+
+    template <>
+    struct StageList< seq<> > {
+        using type = TypeList<>;
+    };
+
+    template <typename E0, typename ...Es>
+    struct StageList< seq< E0, Es... >> {
+        using type = decltype( StageList<E0>::type::Append( typename StageList< seq< Es... >>::type{} ));
+    };
+
+    template <typename ...Es>
+    struct StageList< join< Es... >> {
+        using type = typename StageList< seq< Es... >>::type;
+    };
+
+
+    template <size_t N>
+    struct StaticGraph
+    {
+        using Set_t = std::array< bool, N >;
+
+        std::array< uint32_t, N >   depCount    {};
+        std::array< Set_t, N >      successors  {};     // successors[from][to]
+        Set_t                       exits       {};     // stages without successors
+    };
+
+    // Add edges from 'entry' stages to the element, returns stages which finish the element in 'exit'.
+    template <typename E>
+    struct GraphBuilder
+    {
+        template <size_t N>
+        static constexpr void  Build (StaticGraph<N> &g, size_t &next, const typename StaticGraph<N>::Set_t &entry, typename StaticGraph<N>::Set_t &exit)
+        {
+            const size_t    id = next++;
+            for (size_t i = 0; i < N; ++i)
+            {
+                if ( entry[i] )
+                {
+                    g.successors[i][id] = true;
+                    ++g.depCount[id];
+                }
+            }
+            exit     = {};
+            exit[id] = true;
+        }
+    };
+
+    template <typename ...Es>
+    struct GraphBuilder< seq< Es... >>
+    {
+        template <size_t N>
+        static constexpr void  Build (StaticGraph<N> &g, size_t &next, const typename StaticGraph<N>::Set_t &entry, typename StaticGraph<N>::Set_t &exit)
+        {
+            typename StaticGraph<N>::Set_t  cur = entry;
+            ((GraphBuilder<Es>::Build( g, next, cur, exit ), cur = exit), ...);
+            exit = cur;
+        }
+    };
+
+    template <typename ...Es>
+    struct GraphBuilder< join< Es... >>
+    {
+        template <size_t N>
+        static constexpr void  Build (StaticGraph<N> &g, size_t &next, const typename StaticGraph<N>::Set_t &entry, typename StaticGraph<N>::Set_t &exit)
+        {
+            typename StaticGraph<N>::Set_t  result {};
+            typename StaticGraph<N>::Set_t  branch {};
+
+            ((GraphBuilder<Es>::Build( g, next, entry, branch ), Merge( result, branch )), ...);
+            exit = result;
+        }
+
+        template <size_t N>
+        static constexpr void  Merge (std::array< bool, N > &dst, const std::array< bool, N > &src)
+        {
+            for (size_t i = 0; i < N; ++i) {
+                dst[i] = dst[i] or src[i];
+            }
+        }
+    };
+
+
+    template <typename List>
+    struct StageTuple;
+
+    template <typename ...Types>
+    struct StageTuple< TypeList< Types... >> {
+        using type = std::tuple< Types... >;
+    };
+
+} // _hidden_
+
+
+template <typename ...Elements>
+struct StaticPipeline
+{
+private:
+    using Root_t    = seq< Elements... >;
+    using Stages_t  = typename _hidden_::StageTuple< typename _hidden_::StageList< Root_t >::type >::type;
+
+public:
+    static constexpr size_t     StageCount  = std::tuple_size_v< Stages_t >;
+
+private:
+    static constexpr auto       Graph       = [] ()
+    {
+        _hidden_::StaticGraph< StageCount >     g;
+        typename decltype(g)::Set_t             entry {};
+        size_t                                  next  = 0;
+
+        _hidden_::GraphBuilder< Root_t >::Build( g, next, entry, g.exits );
+        return g;
+    }();
+
+    // Task which executes a single stage.
+    // The last node completes the pipeline, it is never added to the queue, same as 'CompletionTask'.
+    // Successors are started when the stage is complete, but the pipeline is complete only when the task system
+    // has released all nodes, otherwise the next 'start()' may reset a node while 'TaskSystem::execute()' still uses it.
+    struct Node final : public TaskState<void>
+    {
+        friend struct StaticPipeline;
+
+        StaticPipeline*         owner   = nullptr;
+        uint32_t                index   = 0;
+        std::atomic<uint32_t>   remaining {0};
+
+    private:
+        void  reset (Status status, uint32_t depCount)
+        {
+            assert( _refCount.load() == 0 or is_complete() );
+            _status.store( status );
+            _waitCount.store( 0 );
+            remaining.store( depCount );
+        }
+
+        void  run () override
+        {
+            ExecTable[index]( owner->_stages );
+            this->set_completed();
+            owner->on_stage_completed( index );
+        }
+
+        // Node is owned by pipeline, the last reference is released when task system has finished with the node.
+        void  release () override
+        {
+            if ( index < StageCount )
+                owner->on_stage_released();
+        }
+    };
+
+    using ExecFn_t = void (*) (Stages_t &);
+
+    template <size_t I>
+    static void  ExecStage (Stages_t &stages)  { std::get<I>( stages )(); }
+
+    template <size_t ...I>
+    static constexpr std::array< ExecFn_t, StageCount >  MakeTable (std::index_sequence<I...>)  { return {{ &ExecStage<I>... }}; }
+
+    static constexpr auto   ExecTable = MakeTable( std::make_index_sequence< StageCount >{} );
+
+private:
+    Stages_t                                _stages;
+    std::array< Node, StageCount + 1 >      _nodes;     // the last node is the pipeline completion
+    TaskSystem*                             _ts         = nullptr;
+    std::atomic<uint32_t>                   _unreleased {0};
+
+public:
+    StaticPipeline ()
+    {
+        for (uint32_t i = 0; i < _nodes.size(); ++i)
+        {
+            _nodes[i].owner = this;
+            _nodes[i].index = i;
+        }
+        // pipeline is complete before the first run
+        _nodes[StageCount].reset( Node::Status::Completed, 0 );
+
+        // capacity is kept between runs, see 'AsyncTask::set_completed()'
+        _nodes[StageCount]._waiters.reserve( 4 );
+    }
+
+    StaticPipeline (const StaticPipeline &) = delete;
+    StaticPipeline&  operator = (const StaticPipeline &) = delete;
+
+    [[nodiscard]] Stages_t&  stages ()                  { return _stages; }
+
+    template <size_t I>
+    [[nodiscard]] auto&  stage ()                       { return std::get<I>( _stages ); }
+
+    // Returns task which is complete when all stages are complete, can be awaited.
+    [[nodiscard]] Task<>  task ()                       { return Task<>{ &_nodes[StageCount] }; }
+    [[nodiscard]] bool    is_complete () const          { return _nodes[StageCount].is_complete(); }
+
+    // Add stages without dependencies to the task system, previous run must be complete.
+    void  start (TaskSystem &ts)
+    {
+        assert( is_complete() );
+        _ts = &ts;
+
+        for (uint32_t i = 0; i < StageCount; ++i) {
+            _nodes[i].reset( Node::Status::Initial, Graph.depCount[i] );
+        }
+        _nodes[StageCount].reset( Node::Status::InProgress, 0 );
+        _unreleased.store( StageCount );
+
+        for (uint32_t i = 0; i < StageCount; ++i)
+        {
+            if ( Graph.depCount[i] == 0 )
+                ts.add( RC<AsyncTask>{ &_nodes[i] });
+        }
+    }
+
+private:
+    void  on_stage_completed (uint32_t index)
+    {
+        // successors are known at compile time
+        for (uint32_t i = 0; i < StageCount; ++i)
+        {
+            if ( Graph.successors[index][i] and _nodes[i].remaining.fetch_sub( 1 ) == 1 )
+                _ts->add( RC<AsyncTask>{ &_nodes[i] });
+        }
+    }
+
+    // All stages are complete when all nodes are released.
+    void  on_stage_released ()
+    {
+        if ( _unreleased.fetch_sub( 1 ) == 1 )
+            _nodes[StageCount].set_completed();
+    }
+};
+
+template <typename ...Elements>
+using pipeline = StaticPipeline< Elements... >;
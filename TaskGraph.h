@@ -0,0 +1,394 @@
+#pragma once
+
+#include "TaskSystem.h"
+#include <unordered_map>
+#include <iomanip>
+
+
+// Executed task graph: tasks with timestamps and dependencies between them.
+struct TaskGraph
+{
+    using TimePoint_t   = std::chrono::steady_clock::time_point;
+    using Duration_t    = std::chrono::nanoseconds;
+
+    struct Node
+    {
+        std::string     name;
+        TimePoint_t     ready;          // first time when task is added to the queue
+        TimePoint_t     start;          // first time when task is executed
+        TimePoint_t     finish;
+        Duration_t      work    {0};    // sum of all executions, without suspended time
+        bool            started     = false;
+        bool            finished    = false;
+    };
+
+    struct Edge
+    {
+        uint32_t        from;           // dependency
+        uint32_t        to;             // task which waits for dependency
+        TimePoint_t     resumed     {}; // when 'to' is executed after 'from' is finished
+        bool            hasResumed  = false;
+    };
+
+    std::vector< Node >     nodes;
+    std::vector< Edge >     edges;
+};
+
+
+// Records task graph from task system events.
+// Usage: 'TaskGraphRecorder rec;  ts.set_recorder( &rec );  ...;  ts.set_recorder( nullptr );  auto g = rec.graph();'
+struct TaskGraphRecorder final : public TaskRecorder
+{
+private:
+    std::mutex                                          _guard;
+    TaskGraph                                           _graph;
+    std::unordered_map< uint64_t, uint32_t >            _nodeMap;     // 'AsyncTask::sequence_id()' to node
+
+    // Edges which are waiting for the next execution of the task.
+    std::unordered_multimap< uint32_t, uint32_t >       _pendingEdges;
+
+public:
+    TaskGraphRecorder () {}
+
+    void  on_ready (const AsyncTask &task, TimePoint_t time) override
+    {
+        std::scoped_lock    lock {_guard};
+
+        auto&   node = _graph.nodes[ get_node( task )];
+        if ( node.ready == TimePoint_t{} )
+            node.ready = time;
+    }
+
+    void  on_run (const AsyncTask &task, TimePoint_t begin, TimePoint_t end) override
+    {
+        std::scoped_lock    lock {_guard};
+
+        const uint32_t  id      = get_node( task );
+        auto&           node    = _graph.nodes[id];
+
+        if ( not node.started )
+        {
+            node.start      = begin;
+            node.started    = true;
+        }
+        node.work += end - begin;
+
+        // Task is resumed after dependencies are finished.
+        // 'on_run()' is called when 'run()' returns, dependency can be finished while 'run()' which waits for it
+        // is still executed, then the edge is resolved by the next execution.
+        auto [first, last] = _pendingEdges.equal_range( id );
+        for (auto it = first; it != last;)
+        {
+            auto&   e       = _graph.edges[ it->second ];
+            auto&   from    = _graph.nodes[ e.from ];
+
+            if ( from.finished and begin >= from.finish )
+            {
+                e.resumed       = begin;
+                e.hasResumed    = true;
+                it = _pendingEdges.erase( it );
+            }
+            else
+                ++it;
+        }
+    }
+
+    void  on_complete (const AsyncTask &task, TimePoint_t time) override
+    {
+        std::scoped_lock    lock {_guard};
+
+        auto&   node = _graph.nodes[ get_node( task )];
+        node.finish     = time;
+        node.finished   = true;
+    }
+
+    void  on_dependency (const AsyncTask &task, const AsyncTask &dep, bool depComplete) override
+    {
+        std::scoped_lock    lock {_guard};
+
+        const uint32_t  to      = get_node( task );
+        const uint32_t  from    = get_node( dep );
+        auto&           e       = _graph.edges.emplace_back( TaskGraph::Edge{ from, to });
+
+        // Task does not suspend on complete dependency, so there is no scheduling delay.
+        // If recording is started after the dependency is finished its finish time is unknown and the edge stays unresolved.
+        if ( depComplete )
+        {
+            const auto&     node = _graph.nodes[ from ];
+            if ( node.finished )
+            {
+                e.resumed       = node.finish;
+                e.hasResumed    = true;
+            }
+        }
+        else
+            _pendingEdges.emplace( to, uint32_t(_graph.edges.size()-1) );
+    }
+
+    // Returns copy of the recorded graph.
+    [[nodiscard]] TaskGraph  graph ()
+    {
+        std::scoped_lock    lock {_guard};
+        return _graph;
+    }
+
+    void  clear ()
+    {
+        std::scoped_lock    lock {_guard};
+        _graph = {};
+        _nodeMap.clear();
+        _pendingEdges.clear();
+    }
+
+private:
+    [[nodiscard]] uint32_t  get_node (const AsyncTask &task)
+    {
+        const uint64_t  seq             = task.sequence_id();
+        auto [it, inserted]             = _nodeMap.emplace( seq, uint32_t(_graph.nodes.size()) );
+
+        if ( inserted )
+        {
+            // address can be the same for different tasks, sequence id makes the name unique
+            auto&   node = _graph.nodes.emplace_back();
+            node.name = task.name() + "#" + std::to_string( seq );
+        }
+        return it->second;
+    }
+};
+
+
+// Result of critical path analysis.
+struct CriticalPathReport
+{
+    using Duration_t = TaskGraph::Duration_t;
+
+    // Task is ready when all dependencies which it waits for are finished, only the last finished of them
+    // has scheduling delay, time spent waiting for other dependencies is a part of the graph structure.
+    struct EdgeDelay
+    {
+        uint32_t        edge;
+        Duration_t      delay;          // time between task readiness and its execution
+    };
+
+    Duration_t                  wall        {0};    // from the first ready task to the last finished task
+    Duration_t                  work        {0};    // sum of work of all tasks
+    Duration_t                  span        {0};    // work on the critical path
+    double                      parallelism = 0.0;  // work / span, maximal speedup on any number of threads
+    std::vector< uint32_t >     path;               // critical path, from the first to the last task
+    std::vector< uint32_t >     pathEdges;          // edges between tasks of the critical path
+    std::vector< EdgeDelay >    delays;             // sorted by delay, the longest first
+    Duration_t                  pathDelay   {0};    // scheduling delay on the critical path
+
+    [[nodiscard]] std::string  to_text (const TaskGraph &graph, size_t maxEdges = 10) const;
+};
+
+
+// Compute critical path by work of tasks, the graph must be acyclic.
+[[nodiscard]] inline CriticalPathReport  analyze_critical_path (const TaskGraph &graph)
+{
+    using Duration_t = TaskGraph::Duration_t;
+
+    CriticalPathReport  report;
+    const size_t        count = graph.nodes.size();
+
+    if ( count == 0 )
+        return report;
+
+    // topological order
+    std::vector< uint32_t >                 order;
+    std::vector< uint32_t >                 inDegree    ( count, 0 );
+    std::vector< std::vector< uint32_t >>   outEdges    ( count );
+
+    for (uint32_t i = 0; i < graph.edges.size(); ++i)
+    {
+        ++inDegree[ graph.edges[i].to ];
+        outEdges[ graph.edges[i].from ].push_back( i );
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if ( inDegree[i] == 0 )
+            order.push_back( i );
+    }
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        for (uint32_t e : outEdges[ order[i] ])
+        {
+            if ( --inDegree[ graph.edges[e].to ] == 0 )
+                order.push_back( graph.edges[e].to );
+        }
+    }
+    assert( order.size() == count );  // cycle
+
+    // longest path
+    std::vector< Duration_t >   finish  ( count, Duration_t{0} );
+    std::vector< int64_t >      prevEdge( count, -1 );
+
+    for (uint32_t id : order)
+    {
+        finish[id] += graph.nodes[id].work;
+
+        for (uint32_t e : outEdges[id])
+        {
+            const uint32_t  to = graph.edges[e].to;
+            if ( finish[id] > finish[to] )
+            {
+                finish[to]      = finish[id];
+                prevEdge[to]    = e;
+            }
+        }
+    }
+
+    // scheduling delays
+    // Dependencies can be awaited one by one, so the task is ready for the resumption when all dependencies
+    // which are finished before it are finished. Only the last finished of them carries the delay.
+    std::vector< std::vector< uint32_t >>   inEdges ( count );
+    std::vector< int64_t >                  delayNs ( graph.edges.size(), -1 );
+
+    for (uint32_t i = 0; i < graph.edges.size(); ++i) {
+        inEdges[ graph.edges[i].to ].push_back( i );
+    }
+    for (uint32_t i = 0; i < graph.edges.size(); ++i)
+    {
+        const auto&     e = graph.edges[i];
+        if ( not e.hasResumed )
+            continue;
+
+        const auto  finishOf    = graph.nodes[ e.from ].finish;
+        auto        ready       = finishOf;
+
+        for (uint32_t j : inEdges[ e.to ])
+        {
+            const auto&     dep = graph.nodes[ graph.edges[j].from ];
+            if ( dep.finished and dep.finish <= e.resumed )
+                ready = std::max( ready, dep.finish );
+        }
+
+        if ( ready == finishOf )
+        {
+            delayNs[i] = (e.resumed - ready).count();
+            report.delays.push_back({ i, e.resumed - ready });
+        }
+    }
+    std::sort( report.delays.begin(), report.delays.end(), [] (auto& lhs, auto& rhs) { return lhs.delay > rhs.delay; });
+
+    uint32_t    last = uint32_t(std::max_element( finish.begin(), finish.end() ) - finish.begin());
+    report.span = finish[last];
+
+    for (int64_t e = prevEdge[last];; e = prevEdge[last])
+    {
+        report.path.push_back( last );
+        if ( e < 0 )
+            break;
+
+        report.pathEdges.push_back( uint32_t(e) );
+        if ( delayNs[ size_t(e) ] > 0 )
+            report.pathDelay += Duration_t{ delayNs[ size_t(e) ]};
+
+        last = graph.edges[ size_t(e) ].from;
+    }
+    std::reverse( report.path.begin(), report.path.end() );
+    std::reverse( report.pathEdges.begin(), report.pathEdges.end() );
+
+    // totals
+    auto    first   = TaskGraph::TimePoint_t::max();
+    auto    end     = TaskGraph::TimePoint_t::min();
+
+    for (auto& n : graph.nodes)
+    {
+        report.work += n.work;
+
+        if ( n.ready != TaskGraph::TimePoint_t{} )
+            first = std::min( first, n.ready );
+        if ( n.finished )
+            end = std::max( end, n.finish );
+    }
+    if ( first < end )
+        report.wall = end - first;
+
+    report.parallelism = report.span.count() > 0 ? double(report.work.count()) / double(report.span.count()) : 0.0;
+
+    return report;
+}
+
+
+inline std::string  CriticalPathReport::to_text (const TaskGraph &graph, size_t maxEdges) const
+{
+    const auto  ToMs = [] (Duration_t d) { return std::chrono::duration_cast< std::chrono::duration<double, std::milli> >( d ).count(); };
+
+    std::stringstream   str;
+    str << std::fixed << std::setprecision( 3 )
+        << "tasks:       " << graph.nodes.size() << ", edges: " << graph.edges.size() << "\n"
+        << "wall:        " << ToMs( wall ) << " ms\n"
+        << "work:        " << ToMs( work ) << " ms\n"
+        << "span:        " << ToMs( span ) << " ms\n"
+        << "parallelism: " << std::setprecision( 2 ) << parallelism << std::setprecision( 3 ) << "\n"
+        << "critical path (" << path.size() << " tasks, scheduling delay " << ToMs( pathDelay ) << " ms):";
+
+    for (uint32_t id : path) {
+        str << " " << graph.nodes[id].name;
+    }
+    str << "\n";
+
+    if ( not delays.empty() )
+    {
+        str << "longest scheduling delays:\n";
+        for (size_t i = 0; i < std::min( maxEdges, delays.size() ); ++i)
+        {
+            const auto&     e = graph.edges[ delays[i].edge ];
+            str << "  " << graph.nodes[ e.from ].name << " -> " << graph.nodes[ e.to ].name << ": " << ToMs( delays[i].delay ) << " ms\n";
+        }
+    }
+    return str.str();
+}
+
+
+// Export graph in DOT format, critical path is highlighted, edges which carry scheduling delay are labeled with it.
+[[nodiscard]] inline std::string  to_dot (const TaskGraph &graph, const CriticalPathReport &report)
+{
+    const auto  ToUs = [] (TaskGraph::Duration_t d) { return std::chrono::duration_cast< std::chrono::duration<double, std::micro> >( d ).count(); };
+
+    std::vector<bool>   onPath ( graph.nodes.size(), false );
+    for (uint32_t id : report.path) {
+        onPath[id] = true;
+    }
+
+    std::vector<bool>   edgeOnPath ( graph.edges.size(), false );
+    for (uint32_t e : report.pathEdges) {
+        edgeOnPath[e] = true;
+    }
+
+    std::vector< int64_t >  delayNs ( graph.edges.size(), -1 );
+    for (auto& d : report.delays) {
+        delayNs[ d.edge ] = d.delay.count();
+    }
+
+    std::stringstream   str;
+    str << std::fixed << std::setprecision( 1 )
+        << "digraph TaskGraph {\n"
+        << "  node [shape=box];\n";
+
+    for (uint32_t i = 0; i < graph.nodes.size(); ++i)
+    {
+        const auto&     n = graph.nodes[i];
+        str << "  n" << i << " [label=\"" << n.name << "\\nwork " << ToUs( n.work ) << " us\"";
+        if ( onPath[i] )
+            str << ", color=red, penwidth=2";
+        str << "];\n";
+    }
+
+    for (uint32_t i = 0; i < graph.edges.size(); ++i)
+    {
+        const auto&     e = graph.edges[i];
+        str << "  n" << e.from << " -> n" << e.to;
+        if ( delayNs[i] >= 0 )
+            str << " [label=\"" << ToUs( TaskGraph::Duration_t{ delayNs[i] }) << " us\"";
+        else
+            str << " [style=" << (e.hasResumed ? "solid" : "dashed");
+
+        if ( edgeOnPath[i] )
+            str << ", color=red";
+        str << "];\n";
+    }
+    str << "}\n";
+    return str.str();
+}
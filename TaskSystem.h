@@ -1,3 +1,5 @@
+#pragma once
+
 #include "Common.h"
 #include <array>
 #include <atomic>
@@ -6,22 +8,182 @@
 #include <algorithm>
 #include <tuple>
 #include <sstream>
+#include <memory>
+#include <utility>
+#include <chrono>
+#include <span>
+#include <ranges>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <optional>
+#include <typeinfo>
+#include <bit>
+#include <iomanip>
+#include <random>
+#include <numeric>
+#include "FrameArena.h"
+#include "FrameProfiler.h"
+
+#if defined(__GNUC__) or defined(__clang__)
+#   include <cxxabi.h>
+#endif
 
 
 template <typename T>
 struct RC;
 
+struct TaskSystem;
+struct Strand;
+struct TickClock;
+struct AwaitProfiler;
+
+
+// Thread where task must be executed, non-negative value is a worker index.
+enum class ThreadAffinity : int
+{
+    Any     = -1,   // any worker thread
+    Main    = -2,   // thread which calls 'TaskSystem::process_main_thread()'
+};
+
+struct WorkerIndex
+{
+    int     value;
+};
+
+
+// Each priority has its own FIFO lane in the worker queue.
+enum class TaskPriority : unsigned
+{
+    High,
+    Normal,
+    Low,
+    _Count
+};
+
+// Estimated duration of the task, used for load balancing, see 'TaskSystem::set_cost_balancing()'.
+// Can be passed to 'TaskSystem::add()' or as a parameter of the coroutine.
+struct TaskCost
+{
+    std::chrono::nanoseconds    value   {0};
+};
+
+// Returns demangled type name.
+[[nodiscard]] std::string  demangle_name (const char* name);
+
+// Allocate coroutine frame, shared state or dependency array.
+// Uses frame arena of the task system if it is installed, otherwise uses heap.
+[[nodiscard]] void*  allocate_task_memory (size_t size);
+void                 deallocate_task_memory (void* ptr, size_t size);
+
+// Allocate task memory which can outlive the frame arena scope, it is always in heap.
+[[nodiscard]] void*  allocate_task_heap_memory (size_t size);
+void                 deallocate_task_heap_memory (void* ptr, size_t size);
+
+
+// Memory which is allocated by 'allocate_task_memory()'.
+struct TaskMemoryStats
+{
+    size_t  liveBytes   = 0;
+    size_t  peakBytes   = 0;
+    size_t  totalBytes  = 0;    // sum of all allocations
+};
+
+[[nodiscard]] TaskMemoryStats  task_memory_stats ();
+void                           reset_task_memory_peak ();
+
+
+// Pool of fixed-size blocks for shared state of lambda tasks and their captures.
+// Each thread has its own free list per size class, so allocation and deallocation take no lock,
+// block which is released by another thread goes to the free list of that thread.
+// Blocks are counted in 'task_memory_stats()' while they are used.
+struct TaskPool
+{
+    static constexpr size_t     Granularity = 64;
+    static constexpr size_t     ClassCount  = 8;        // blocks up to 512 bytes, larger blocks are allocated in heap
+    static constexpr size_t     MaxFree     = 4096;     // per thread and size class, other blocks are returned to heap
+
+    [[nodiscard]] static void*  Allocate (size_t size);
+    static void                 Deallocate (void* ptr, size_t size);
+
+private:
+    struct Block
+    {
+        Block*      next;
+    };
+
+    struct FreeList
+    {
+        Block*      head    = nullptr;
+        size_t      count   = 0;
+
+        ~FreeList ();
+    };
+
+    static thread_local FreeList    _lists [ClassCount];
+
+    [[nodiscard]] static size_t  _Class (size_t size)   { return (size + Granularity - 1) / Granularity - 1; }
+};
+
+inline thread_local TaskPool::FreeList  TaskPool::_lists [TaskPool::ClassCount];
+
+
+// Allocator for containers which are owned by the task.
+template <typename T>
+struct TaskAllocator
+{
+    using value_type = T;
+
+    TaskAllocator () {}
+
+    template <typename A>
+    TaskAllocator (const TaskAllocator<A> &) {}
+
+    [[nodiscard]] T*  allocate (size_t n)                    { return static_cast<T*>( allocate_task_memory( sizeof(T) * n )); }
+    void              deallocate (T* ptr, size_t n)          { deallocate_task_memory( ptr, sizeof(T) * n ); }
 
-// Base class for coroutine promise type.
+    template <typename A>
+    [[nodiscard]] bool  operator == (const TaskAllocator<A> &) const    { return true; }
+};
+
+// Allocator for containers which are owned by the task and can grow after the frame arena scope is closed.
+template <typename T>
+struct TaskHeapAllocator
+{
+    using value_type = T;
+
+    TaskHeapAllocator () {}
+
+    template <typename A>
+    TaskHeapAllocator (const TaskHeapAllocator<A> &) {}
+
+    [[nodiscard]] T*  allocate (size_t n)                    { return static_cast<T*>( allocate_task_heap_memory( sizeof(T) * n )); }
+    void              deallocate (T* ptr, size_t n)          { deallocate_task_heap_memory( ptr, sizeof(T) * n ); }
+
+    template <typename A>
+    [[nodiscard]] bool  operator == (const TaskHeapAllocator<A> &) const    { return true; }
+};
+
+
+// Base class for shared state of the task.
 struct AsyncTask
 {
     friend struct TaskSystem;
+    friend struct Strand;
+    friend struct TickClock;
+    friend struct AwaitProfiler;
 
     template <typename T>
     friend struct RC;
 
+public:
+    using TimePoint_t   = std::chrono::steady_clock::time_point;
+
 protected:
-    using Deps_t = std::vector< RC<AsyncTask> >;
+    // Waiters are added to the long-lived task while the arena scope is active and capacity is kept
+    // for reused tasks, so they are not allocated in the frame arena, otherwise 'FrameArena::reset()' may never succeed.
+    using Waiters_t     = std::vector< RC<AsyncTask>, TaskHeapAllocator< RC<AsyncTask> >>;
 
     enum class Status : unsigned
     {
@@ -35,24 +197,84 @@ protected:
     std::atomic<int>    _refCount   {0};
     std::atomic<Status> _status     {Status::Initial};
 
-    std::mutex          _depsGuard;
-    Deps_t              _deps;
+    // Tasks which wait for completion of this task.
+    std::mutex          _waitersGuard;
+    Waiters_t           _waiters;
+
+    // Number of incomplete dependencies.
+    // While task is executed it is increased by 1, so task can not be added to the queue until 'run()' returns.
+    std::atomic<int>    _waitCount  {0};
+
+    // Task system which executes the task.
+    // Can be changed by 'schedule_on()', then task will be added to the new system.
+    TaskSystem*         _system     = nullptr;
+
+    // Can be changed by 'switch_to()'.
+    ThreadAffinity      _affinity   = ThreadAffinity::Any;
+
+    TaskPriority        _priority   = TaskPriority::Normal;
+
+    // Tasks with deadline are scheduled by earliest deadline first.
+    TimePoint_t         _deadline   = TimePoint_t::max();
+
+    // Task systems which count the task for admission control, see 'TaskSystem::set_task_limit()'.
+    // Task is counted as in flight from the first time it is added until it is complete,
+    // and as queued while it is in the queue.
+    TaskSystem*         _inFlightOf = nullptr;
+    TaskSystem*         _queuedOf   = nullptr;
+
+    // Task is always executed by the strand, can be changed by 'Strand::schedule()'.
+    Strand*             _strand     = nullptr;
+
+    // Intrusive list of tasks in the strand queue.
+    AsyncTask*          _strandNext = nullptr;
+
+    // See 'sequence_id()'.
+    mutable std::atomic<uint64_t>   _seqId  {0};
+
+    // Estimated duration in nanoseconds, if it is 0 then duration of the task type is used.
+    int64_t             _costHint   = 0;
 
 public:
     [[nodiscard]] bool  is_complete ()      const   { return _status.load() == Status::Completed; }
-    [[nodiscard]] bool  has_dependencies ()         { std::scoped_lock lock {_depsGuard};  return not _deps.empty(); }
+    [[nodiscard]] bool  has_dependencies () const   { return _waitCount.load() > 0; }
 
-    // Returns pointer to coroutine as string.
+    // Must be set before the task is added.
+    void  set_cost_hint (TaskCost cost)             { _costHint = cost.value.count(); }
+
+    // Returns pointer to task as string.
     // Can be used for debugging.
     [[nodiscard]] std::string  name ()     const;
 
+    // Returns unique id of the task, unlike the address it is not reused by other tasks.
+    // Id is assigned on the first call, so tasks which are not inspected have no overhead.
+    [[nodiscard]] uint64_t  sequence_id () const;
+
+    // Returns identifier of the task type, tasks with the same function have the same type.
+    // Used to collect per-type stats.
+    [[nodiscard]] virtual const void*  type_id () const     { return &typeid(*this); }
+
+    // Returns readable name of the task type, it is slow.
+    [[nodiscard]] virtual std::string  type_name () const;
+
+    // Returns 'true' if task graph is recorded, then dependencies must be added even if they are complete.
+    [[nodiscard]] bool  has_recorder () const;
+
+    // Returns 'true' if the current task must wait for dependency.
     template <typename Arg0, typename ...Args>
-    void  add_dependencies (Arg0&& arg0, Args&& ...deps);
-    void  add_dependency (AsyncTask* dep);
+    bool  add_dependencies (Arg0&& arg0, Args&& ...deps);
+    bool  add_dependency (AsyncTask* dep);
+
+    // allocate shared state
+    static void*  operator new (size_t size)            { return allocate_task_memory( size ); }
+    static void   operator delete (void* ptr, size_t size)  { deallocate_task_memory( ptr, size ); }
 
 protected:
     virtual ~AsyncTask ();
 
+    // Mark task as completed and add waiting tasks to the queue if all their dependencies are complete.
+    void  set_completed ();
+
     // Execute task/coroutine.
     virtual void  run () = 0;
 
@@ -123,32 +345,22 @@ private:
 };
 
 
-AsyncTask::~AsyncTask ()
+inline AsyncTask::~AsyncTask ()
 {
     assert( _refCount.load() == 0 );
 }
 
 
-// Add input dependency to current task/coroutine.
-// Task must be added back to task queue to wait until all input dependency are complete.
-inline void  AsyncTask::add_dependency (AsyncTask* dep)
-{
-    assert( _status.load() == Status::InProgress ); // if inside coroutine
-    
-    std::scoped_lock  lock {_depsGuard};
-    _deps.push_back( RC<AsyncTask>{ dep });
-}
-
-
 template <typename Arg0, typename ...Args>
-void  AsyncTask::add_dependencies (Arg0&& arg0, Args&& ...args)
+bool  AsyncTask::add_dependencies (Arg0&& arg0, Args&& ...args)
 {
-    add_dependency( arg0 );
+    bool    wait = add_dependency( arg0 );
 
     if constexpr( sizeof...(Args) > 0 )
     {
-        add_dependencies( std::forward<Args>(args) ... );
+        wait = add_dependencies( std::forward<Args>(args) ... ) or wait;
     }
+    return wait;
 }
 
 
@@ -157,67 +369,199 @@ template <typename T = void>
 struct Task;
 
 
+// Shared state of the task, contains result.
+// It is separated from coroutine frame, so the frame can be destroyed when coroutine is complete,
+// but the result is alive until the last reference is released.
+template <typename T>
+struct TaskState : public AsyncTask
+{
+    template <typename>
+    friend struct Task;
+
+protected:
+    T                   _result;
+    std::exception_ptr  _exception;
+
+public:
+    // Returns copy of result because it can be used many times.
+    // Move-ctor requires additional synchronization.
+    // Rethrows exception if task is completed with exception.
+    [[nodiscard]] T     get_result () const
+    {
+        assert( is_complete() );
+        if ( _exception )
+            std::rethrow_exception( _exception );
+        return _result;
+    }
+};
+
+template <>
+struct TaskState <void> : public AsyncTask
+{
+    template <typename>
+    friend struct Task;
+
+protected:
+    std::exception_ptr  _exception;
+
+public:
+    void    get_result () const
+    {
+        assert( is_complete() );
+        if ( _exception )
+            std::rethrow_exception( _exception );
+    }
+};
+
+
+// Shared state which owns coroutine frame until the coroutine is complete.
+template <typename T>
+struct CoroutineTask final : public TaskState<T>
+{
+    template <typename>
+    friend struct Task;
+
+private:
+    std::coroutine_handle<>     _coro;
+
+    // Name of the coroutine function from 'std::source_location' which is captured in 'get_return_object()',
+    // the string is static, so its address is the same for all frames of the coroutine function.
+    // Coroutines with the same name, for example lambdas in the same function, share the type.
+    const char* const           _function;
+
+public:
+    CoroutineTask (std::coroutine_handle<> coro, const char* function) : _coro{coro}, _function{function} {}
+
+    [[nodiscard]] const void*  type_id () const override    { return _function; }
+    [[nodiscard]] std::string  type_name () const override  { return _function; }
+
+private:
+    void  run () override
+    {
+        assert( this->_status.load() == AsyncTask::Status::InProgress );
+
+        // resume coroutine
+        _coro.resume();
+
+        // If coroutine is complete - destroy frame with all locals and mark as completed,
+        // otherwise it will be added back to queue.
+        if ( _coro.done() )
+        {
+            _coro.destroy();
+            _coro = {};
+
+            this->set_completed();
+        }
+    }
+
+    void  release () override
+    {
+        // destroy coroutine if it is not complete, it implicitly calls 'promise_type' destructor
+        if ( _coro )
+            _coro.destroy();
+
+        delete this;
+    }
+};
+
+
+// Base class for promise types of coroutines which are executed by the task system.
+struct AsyncTaskPromise
+{
+protected:
+    // Shared state which owns the coroutine frame.
+    AsyncTask*  _task   = nullptr;
+
+public:
+    [[nodiscard]] AsyncTask&  task ()   const   { assert( _task != nullptr );  return *_task; }
+
+protected:
+    // Cost hint from the coroutine parameter.
+    TaskCost    _cost;
+
+    template <typename A>
+    void  _FindCost (const A &arg)
+    {
+        if constexpr( std::is_same_v< A, TaskCost >)
+            _cost = arg;
+    }
+
+public:
+
+#ifdef TASK_FRAME_PROFILER
+    // allocate coroutine frame with header which points to stats of the coroutine function,
+    // default argument is evaluated in the coroutine, so 'loc' points to the coroutine function
+    static void*  operator new (size_t size, std::source_location loc = std::source_location::current())
+    {
+        auto*   site    = FrameProfiler::GetSite( loc );
+        auto*   ptr     = static_cast<std::byte*>( allocate_task_memory( size + FrameProfiler::HeaderSize ));
+
+        FrameProfiler::OnAllocate( site, size );
+        *reinterpret_cast<FrameProfiler::Site**>( ptr ) = site;
+        return ptr + FrameProfiler::HeaderSize;
+    }
+
+    static void  operator delete (void* ptr, size_t size)
+    {
+        auto*   base = static_cast<std::byte*>( ptr ) - FrameProfiler::HeaderSize;
+
+        FrameProfiler::OnDeallocate( *reinterpret_cast<FrameProfiler::Site**>( base ), size );
+        deallocate_task_memory( base, size + FrameProfiler::HeaderSize );
+    }
+#else
+    // allocate coroutine frame
+    static void*  operator new (size_t size)            { return allocate_task_memory( size ); }
+    static void   operator delete (void* ptr, size_t size)  { deallocate_task_memory( ptr, size ); }
+#endif
+};
+
+
 // Task with return value, implements 'promise' pattern.
 template <typename T>
 struct Task
 {
     struct promise_type;
-    using handle_t = std::coroutine_handle< promise_type >;
+    using handle_t  = std::coroutine_handle< promise_type >;
+    using State_t   = TaskState< T >;
 
-    struct promise_type final : public AsyncTask
+    struct promise_type final : public AsyncTaskPromise
     {
-    private:
-        T   _result;
-
     public:
         promise_type ()     {}
 
-        Task<T>             get_return_object ()        { return Task<T>{ handle_t::from_promise( *this )}; }
+        // Coroutine parameter of type 'TaskCost' is used as a cost hint.
+        template <typename ...Args>
+        promise_type (const Args& ...args)                  { (_FindCost( args ), ...); }
+
+        // default argument is evaluated in the coroutine, so 'loc' points to the coroutine function
+        Task<T>  get_return_object (std::source_location loc = std::source_location::current())  { return Task<T>{ _Create( loc )}; }
+
         std::suspend_always initial_suspend () noexcept { return {}; }        // delayed start
         std::suspend_always final_suspend () noexcept   { return {}; }        // avoid 'suspend_never', it immediatly destroy coroutine
-        void                return_value (T value)      { _result = std::move(value); }
-        void                unhandled_exception ()      {}
-
-        [[nodiscard]] auto  get_rc ()                   { return RC<promise_type>{ this }; }
-        [[nodiscard]] T     get_result () const         { assert(is_complete());  return _result; }
+        void                return_value (T value)      { static_cast<State_t *>(_task)->_result = std::move(value); }
+        void                unhandled_exception ()      { static_cast<State_t *>(_task)->_exception = std::current_exception(); }
 
     private:
-        void  run () override
-        {
-            assert( _status.load() == Status::InProgress );
-
-            // resume coroutine
-            auto    coro = handle_t::from_promise( *this );
-            coro.resume();
-
-            // if coroutine is complete - mark as completed, otherwise it will be added back to queue.
-            if ( coro.done() )
-                _status.store( Status::Completed );
-        }
-
-        void  release () override
+        [[nodiscard]] State_t*  _Create (const std::source_location &loc)
         {
-            // destroy coroutine, it implicitly calls 'promise_type' destructor
-            auto    coro = handle_t::from_promise( *this );
-
-            assert( coro.done() );
-            coro.destroy();
+            auto*   state = new CoroutineTask<T>{ handle_t::from_promise( *this ), loc.function_name() };
+            state->set_cost_hint( _cost );
+            _task = state;
+            return state;
         }
     };
 
 private:
-    RC<promise_type>    _ptr;
+    RC< State_t >   _ptr;
         
 public:
     Task ()                                         {}
-    Task (promise_type* ptr) : _ptr{ptr}            {}
-    Task (handle_t h) : _ptr{h.promise().get_rc()}  {}
+    Task (State_t* ptr) : _ptr{ptr}                 {}
     ~Task ()                                        {}
     
-    [[nodiscard]] bool      is_complete ()          { assert( _ptr );  return _ptr->is_complete(); }
+    [[nodiscard]] bool      is_complete ()  const   { assert( _ptr );  return _ptr->is_complete(); }
     [[nodiscard]] bool      has_dependencies ()const{ assert( _ptr );  return _ptr->has_dependencies(); }
-    [[nodiscard]] auto*     to_promise ()           { assert( _ptr );  return _ptr.get(); }
-    [[nodiscard]] handle_t  to_coroutine ()         { assert( _ptr );  return handle_t::from_promise( *_ptr ); }
+    [[nodiscard]] State_t*  to_async_task ()const   { assert( _ptr );  return _ptr.get(); }
 
     // Returns copy of result because it can be used many times.
     // Move-ctor requires additional synchronization.
@@ -227,245 +571,3365 @@ public:
 };
 
 
-// Task without return value? implements 'task/job' pattern.
+// Task without return value, implements 'task/job' pattern.
 template <>
 struct Task <void>
 {
     struct promise_type;
-    using handle_t = std::coroutine_handle< promise_type >;
+    using handle_t  = std::coroutine_handle< promise_type >;
+    using State_t   = TaskState< void >;
 
-    struct promise_type final : public AsyncTask
+    struct promise_type final : public AsyncTaskPromise
     {
     public:
         promise_type ()     {}
 
-        Task<void>          get_return_object ()        { return Task<void>{ handle_t::from_promise( *this )}; }
+        // Coroutine parameter of type 'TaskCost' is used as a cost hint.
+        template <typename ...Args>
+        promise_type (const Args& ...args)                  { (_FindCost( args ), ...); }
+
+        // default argument is evaluated in the coroutine, so 'loc' points to the coroutine function
+        Task<void>  get_return_object (std::source_location loc = std::source_location::current())  { return Task<void>{ _Create( loc )}; }
+
         std::suspend_always initial_suspend () noexcept { return {}; }        // delayed start
         std::suspend_always final_suspend () noexcept   { return {}; }        // avoid 'suspend_never', it immediatly destroy coroutine
         void                return_void ()              {}
-        void                unhandled_exception ()      {}
-
-        [[nodiscard]] auto  get_rc ()                   { return RC<promise_type>{ this }; }
+        void                unhandled_exception ()      { static_cast<State_t *>(_task)->_exception = std::current_exception(); }
 
     private:
-        void  run () override
-        {
-            assert( _status.load() == Status::InProgress );
-
-            auto    coro = handle_t::from_promise( *this );
-            coro.resume();
-
-            if ( coro.done() )
-                _status.store( Status::Completed );
-        }
-
-        void  release () override
+        [[nodiscard]] State_t*  _Create (const std::source_location &loc)
         {
-            auto    coro = handle_t::from_promise( *this );
-
-            assert( coro.done() );
-            coro.destroy();
+            auto*   state = new CoroutineTask<void>{ handle_t::from_promise( *this ), loc.function_name() };
+            state->set_cost_hint( _cost );
+            _task = state;
+            return state;
         }
     };
 
 private:
-    RC<promise_type>    _ptr;
+    RC< State_t >   _ptr;
         
 public:
     Task ()                                         {}
-    Task (promise_type* ptr) : _ptr{ptr}            {}
-    Task (handle_t h) : _ptr{h.promise().get_rc()}  {}
+    Task (State_t* ptr) : _ptr{ptr}                 {}
     ~Task ()                                        {}
     
-    [[nodiscard]] bool      is_complete ()          { assert( _ptr );  return _ptr->is_complete(); }
+    [[nodiscard]] bool      is_complete ()  const   { assert( _ptr );  return _ptr->is_complete(); }
     [[nodiscard]] bool      has_dependencies ()const{ assert( _ptr );  return _ptr->has_dependencies(); }
-    [[nodiscard]] auto*     to_promise ()           { assert( _ptr );  return _ptr.get(); }
-    [[nodiscard]] handle_t  to_coroutine ()         { assert( _ptr );  return handle_t::from_promise( *_ptr ); }
+    [[nodiscard]] State_t*  to_async_task ()const   { assert( _ptr );  return _ptr.get(); }
     
-    void                    get_result ()   const   {}
+    void                    get_result ()   const   { assert( _ptr );  _ptr->get_result(); }
 
     explicit operator bool () const                 { return bool(_ptr); }
 };
 
 
-struct TaskSystem
+// Shared state of the task which is completed by 'TaskCompletionSource', there is no coroutine frame.
+template <typename T>
+struct CompletionTask final : public TaskState<T>
 {
-private:
-    using Status = AsyncTask::Status;
+    template <typename>
+    friend struct TaskCompletionSource;
 
-    // Single task queue for all threads.
-    // It is very slow, for real projects use queue per thread and work stealing.
-    std::mutex                      _queueGuard;
-    std::vector< RC<AsyncTask> >    _queue;
-
-    std::vector< std::thread >      _threads;
-    std::atomic<bool>               _looping    {false};
+private:
+    std::atomic<bool>   _isSet  {false};
 
 public:
-    void  wait ();
-    
-    template <typename T>
-    void  add (Task<T> task);
-    void  add (RC<AsyncTask> task);
-
-    static TaskSystem&  instance ();
-    static TaskSystem&  create (int threadCount);
-    static void         destroy ();
+    // Task is never added to the queue, it is completed by external code.
+    CompletionTask ()   { this->_status.store( AsyncTask::Status::InProgress ); }
 
 private:
-    TaskSystem () {}
+    template <typename Fn>
+    bool  _Complete (Fn &&fn)
+    {
+        // result can be set only once
+        if ( _isSet.exchange( true ))
+            return false;
 
-    void  init_threads (int count);
-    void  process_tasks (size_t seed);
+        fn( *this );
 
-    [[nodiscard]] RC<AsyncTask>  extract_task (size_t first, size_t count);
-};
+        // resume all awaiting coroutines
+        this->set_completed();
+        return true;
+    }
 
+    void  run () override       { assert( false ); }
+    void  release () override   { delete this; }
+};
 
-// Used placement new to avoid false positive warning on memleak
-inline TaskSystem&  TaskSystem::instance ()
-{
-    static std::aligned_storage_t< sizeof(TaskSystem), alignof(TaskSystem) >   ts;
-    return *static_cast<TaskSystem *>( static_cast<void*>( &ts ));
-}
 
-inline TaskSystem&  TaskSystem::create (int threadCount)
+// Bridge between callback-based API and coroutines.
+// Result is stored once in the shared state and available for all awaiting coroutines.
+// 'set_value()' and 'set_exception()' can be called from any thread.
+template <typename T = void>
+struct TaskCompletionSource
 {
-    auto* ts = new(&instance()) TaskSystem{};
-    ts->init_threads( threadCount );
-    return *ts;
-}
+private:
+    using State_t   = CompletionTask< T >;
 
-inline void  TaskSystem::destroy ()
-{
-    instance().~TaskSystem();
-}
+    RC< State_t >   _ptr;
 
+public:
+    TaskCompletionSource () : _ptr{ new State_t{} } {}
 
-// Add task/coroutine to the queue.
-template <typename T>
-inline void  TaskSystem::add (Task<T> task)
-{
-    return add( RC<AsyncTask>{ task.to_promise() });
-}
+    [[nodiscard]] Task<T>   get_task ()     const   { return Task<T>{ _ptr.get() }; }
+    [[nodiscard]] bool      is_complete ()  const   { return _ptr->is_complete(); }
 
-inline void  TaskSystem::add (RC<AsyncTask> task)
-{
-    assert( task );
+    // Returns 'false' if result is already set.
+    template <typename V>
+    bool  set_value (V &&value)
+    {
+        static_assert( not std::is_void_v<T> );
+        return _ptr->_Complete( [&value] (State_t &s) { s._result = std::forward<V>(value); });
+    }
 
-    Status  stat = task->_status.exchange( Status::InQueue );
-    assert( stat == Status::Initial or stat == Status::InProgress );
+    bool  set_value ()
+    {
+        static_assert( std::is_void_v<T> );
+        return _ptr->_Complete( [] (State_t &) {});
+    }
 
-    std::scoped_lock    lock {_queueGuard};
-    _queue.push_back( task );
-}
+    bool  set_exception (std::exception_ptr e)
+    {
+        assert( e );
+        return _ptr->_Complete( [&e] (State_t &s) { s._exception = std::move(e); });
+    }
+};
 
 
-// Find task which is ready to be executed and extract it from the queue.
-inline RC<AsyncTask>  TaskSystem::extract_task (size_t first, size_t count)
+// Task which executes callable object without coroutine frame.
+// Callable is type-erased, so the shared state has the same size for all callables with the same result type
+// and it is allocated from 'TaskPool'. Small callable is stored inside the shared state, large callable is
+// allocated from the pool too. Task is executed when all dependencies are complete.
+// Dependencies are stored out of line, so the task without dependencies pays only for a pointer.
+template <typename T>
+struct FunctionTask final : public TaskState<T>
 {
-    if ( _queue.empty() )
-        return {};
+public:
+    static constexpr size_t     InlineSize  = 32;
 
-    for (size_t i = 0; i < count; ++i)
+private:
+    // Table of functions for the callable type, it is also the task type.
+    struct Ops
     {
-        size_t  idx     = (i + first) % _queue.size();
-        auto&   t       = *_queue[ idx ];
-        bool    ready   = true;
+        void  (*invoke) (FunctionTask &);
+        void  (*destroy) (FunctionTask &);
+        const std::type_info&   type;
+    };
 
-        {
-            std::scoped_lock  lock2 {t._depsGuard};
-            for (auto& dep : t._deps) {
-                ready &= dep->is_complete();
-            }
+    template <typename Fn>
+    struct OpsOf
+    {
+        static constexpr bool   IsInline    = sizeof(Fn) <= InlineSize and alignof(Fn) <= alignof(void*);
 
-            if ( ready )
-            {
-                Status  stat = t._status.exchange( Status::InProgress );
-                assert( stat == Status::InQueue );
+        // Inline callable is in '_storage', otherwise '_storage' contains pointer to the pool block.
+        [[nodiscard]] static Fn&  Get (FunctionTask &self)
+        {
+            if constexpr( IsInline )
+                return *std::launder( reinterpret_cast< Fn* >( self._storage ));
+            else
+                return **std::launder( reinterpret_cast< Fn** >( self._storage ));
+        }
 
-                t._deps.clear();
-            }
+        static void  Invoke (FunctionTask &self)
+        {
+            if constexpr( std::is_void_v<T> )
+                Get( self )();
+            else
+                self._result = Get( self )();
         }
 
-        if ( ready )
+        static void  Destroy (FunctionTask &self)
         {
-            RC<AsyncTask>    task = &t;
-            
-            if ( idx+1 != _queue.size() )
-                _queue[idx] = _queue.back();
+            Fn&     fn = Get( self );
+            fn.~Fn();
 
-            _queue.pop_back();
-            return task;
+            if constexpr( not IsInline )
+                TaskPool::Deallocate( &fn, sizeof(Fn) );
         }
-    }
-
-    return {};
-}
 
+        static constexpr Ops    value   { &Invoke, &Destroy, typeid(Fn) };
+    };
 
-inline void  TaskSystem::process_tasks (size_t seed)
-{
-    const size_t  range_size = 8;
+    // Null-terminated array from the pool, released when dependencies are registered.
+    RC<AsyncTask>*                          _deps   = nullptr;
+    // Pointer alignment avoids padding after the base class, callable with larger alignment is allocated from the pool.
+    alignas(void*) std::byte                _storage [InlineSize];
+    const Ops* const                        _ops;                   // 'AwaitProfiler' reads type while the task is executed
 
-    for (size_t i = 0, count = 1; i < count; i += range_size)
+public:
+    template <typename Fn, typename ...Deps>
+    explicit FunctionTask (Fn &&fn, Deps* ...deps) : _ops{ &OpsOf< std::decay_t< Fn >>::value }
     {
-        RC<AsyncTask>   t;
-        {
-            std::scoped_lock    lock {_queueGuard};
+        using F = std::decay_t< Fn >;
+        static_assert( alignof(F) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ );
 
-            t     = extract_task( i+seed, range_size );
-            count = _queue.size();
+        if constexpr( OpsOf<F>::IsInline )
+            new( _storage ) F{ std::forward<Fn>(fn) };
+        else
+            new( _storage ) F*{ new( TaskPool::Allocate( sizeof(F) )) F{ std::forward<Fn>(fn) }};
+
+        if constexpr( sizeof...(Deps) > 0 )
+        {
+            _deps = static_cast< RC<AsyncTask>* >( TaskPool::Allocate( sizeof(RC<AsyncTask>) * (sizeof...(Deps) + 1) ));
+
+            RC<AsyncTask>*  dst = _deps;
+            ((new( dst++ ) RC<AsyncTask>{ deps }), ...);
+            new( dst ) RC<AsyncTask>{};
+        }
+    }
+
+    // Tasks with the same callable type have the same type.
+    [[nodiscard]] const void*  type_id () const override    { return &_ops->type; }
+    [[nodiscard]] std::string  type_name () const override  { return demangle_name( _ops->type.name() ); }
+
+    // allocate shared state
+    static void*  operator new (size_t size)                { return TaskPool::Allocate( size ); }
+    static void   operator delete (void* ptr, size_t size)  { TaskPool::Deallocate( ptr, size ); }
+
+private:
+    void  release_deps ()
+    {
+        size_t  count = 0;
+        for (; _deps[count]; ++count) {
+            std::destroy_at( &_deps[count] );
+        }
+        std::destroy_at( &_deps[count] );
+
+        TaskPool::Deallocate( std::exchange( _deps, nullptr ), sizeof(RC<AsyncTask>) * (count + 1) );
+    }
+
+    void  run () override
+    {
+        assert( this->_status.load() == AsyncTask::Status::InProgress );
+
+        // Dependencies are registered once, task will be added back to the queue when all of them are complete.
+        // References are not needed after registration, dependency which is not complete holds reference to the task.
+        if ( _deps != nullptr )
+        {
+            bool    wait = false;
+            for (auto* dep = _deps; *dep; ++dep) {
+                wait = this->add_dependency( dep->get() ) or wait;
+            }
+            release_deps();
+
+            if ( wait )
+                return;
+        }
+
+        try {
+            _ops->invoke( *this );
+        }
+        catch (...) {
+            this->_exception = std::current_exception();
+        }
+
+        // destroy captures as soon as possible
+        _ops->destroy( *this );
+
+        this->set_completed();
+    }
+
+    void  release () override
+    {
+        // captures are destroyed by 'run()' before the task is completed
+        if ( not this->is_complete() )
+            _ops->destroy( *this );
+
+        if ( _deps != nullptr )
+            release_deps();
+
+        delete this;
+    }
+};
+
+
+// Create task from callable object, it can be awaited like a coroutine.
+// Task is not added to the task system, it will be scheduled when it is awaited or by 'TaskSystem::add()'.
+template <typename Fn, typename ...Deps>
+[[nodiscard]] auto  make_task (Fn &&fn, const Task<Deps>& ...deps)
+{
+    using T = std::invoke_result_t< std::decay_t<Fn> >;
+
+    return Task<T>{ new FunctionTask<T>{ std::forward<Fn>(fn), static_cast< AsyncTask* >( deps.to_async_task() ) ... }};
+}
+
+
+// Receives events of executed tasks, used to record task graph.
+// Methods are called from any thread.
+struct TaskRecorder
+{
+    using TimePoint_t = std::chrono::steady_clock::time_point;
+
+    virtual ~TaskRecorder () {}
+
+    // Task is added to the queue, first time or after suspension.
+    virtual void  on_ready (const AsyncTask &task, TimePoint_t time) = 0;
+
+    // Task is executed until completion or suspension.
+    virtual void  on_run (const AsyncTask &task, TimePoint_t begin, TimePoint_t end) = 0;
+
+    virtual void  on_complete (const AsyncTask &task, TimePoint_t time) = 0;
+
+    // 'task' waits for 'dep', called even if 'dep' is already complete, then 'depComplete' is 'true'
+    // and the task does not wait for it.
+    virtual void  on_dependency (const AsyncTask &task, const AsyncTask &dep, bool depComplete) = 0;
+};
+
+
+template <typename T>
+inline constexpr bool   IsTask = false;
+
+template <typename T>
+inline constexpr bool   IsTask< Task<T> > = true;
+
+
+// Task system can be created as a normal object, any number of instances can coexist.
+// Each instance has its own threads, queues and stats.
+// 'create()', 'instance()' and 'destroy()' manage the optional default instance.
+struct TaskSystem
+{
+    friend struct AsyncTask;
+    friend struct Strand;
+    friend struct TickClock;
+    friend struct AwaitProfiler;
+
+public:
+    struct Stats
+    {
+        size_t  added           = 0;    // includes tasks which are added back to the queue
+        size_t  executed        = 0;    // number of 'AsyncTask::run()' calls
+        size_t  completed       = 0;
+        size_t  deadlineMissed  = 0;    // tasks which are completed after the deadline
+        size_t  nextSlot        = 0;    // tasks which are executed from the LIFO slot by the owner worker
+        size_t  rejected        = 0;    // 'try_add()' calls which are failed because of limits
+        size_t  producerWaitNs  = 0;    // total time which producers spent waiting for free slots
+        size_t  batches         = 0;    // batches of fine-grained tasks which are extracted under a single lock
+        size_t  batchedTasks    = 0;
+        size_t  queued          = 0;    // current number of tasks in the queues
+        size_t  inFlight        = 0;    // current number of tasks which are added and not complete yet
+    };
+
+    // Stats of tasks with the same 'AsyncTask::type_id()', collected while coarsening or cost balancing is enabled.
+    struct TaskTypeStats
+    {
+        // Bucket 'i' counts executions with duration in [2^(i+7), 2^(i+8)) ns, the first and the last buckets are open.
+        static constexpr unsigned   BucketCount = 16;
+
+        const void*                         typeId      = nullptr;
+        std::string                         typeName;               // 'AsyncTask::type_name()' of the first task of this type
+        size_t                              count       = 0;        // number of 'run()' calls
+        size_t                              batched     = 0;        // executed in batches
+        double                              meanNs      = 0.0;
+        uint32_t                            recentNs    = 0;        // moving average without outliers
+        unsigned                            median      = 0;        // bucket with median of recent durations
+        bool                                fineGrained = false;
+        std::array< size_t, BucketCount >   histogram   {};
+
+        [[nodiscard]] static unsigned  Bucket (int64_t ns)  { return unsigned(std::clamp( int(std::bit_width( uint64_t(std::max<int64_t>( ns, 0 )))) - 8, 0, int(BucketCount) - 1 )); }
+        [[nodiscard]] static int64_t   LowerBound (unsigned bucket) { return bucket == 0 ? 0 : int64_t(1) << (bucket + 7); }
+        [[nodiscard]] static int64_t   UpperBound (unsigned bucket) { return bucket + 1 == BucketCount ? INT64_MAX : int64_t(1) << (bucket + 8); }
+    };
+
+    // Slots for tasks which are acquired by 'reserve()', unused slots are released in destructor.
+    struct Reservation
+    {
+        friend struct TaskSystem;
+
+    private:
+        TaskSystem*     _ts     = nullptr;
+        TaskPriority    _lane   = TaskPriority::Normal;
+        size_t          _count  = 0;
+
+    public:
+        Reservation () {}
+        Reservation (TaskSystem &ts, TaskPriority lane, size_t count) : _ts{&ts}, _lane{lane}, _count{count} {}
+        Reservation (Reservation &&other) : _ts{other._ts}, _lane{other._lane}, _count{std::exchange( other._count, 0 )} {}
+        ~Reservation ()                                 { if ( _count > 0 ) _ts->release_slots( _lane, _count, _count ); }
+
+        Reservation&  operator = (Reservation &&rhs)
+        {
+            if ( _count > 0 )
+                _ts->release_slots( _lane, _count, _count );
+
+            _ts     = rhs._ts;
+            _lane   = rhs._lane;
+            _count  = std::exchange( rhs._count, 0 );
+            return *this;
+        }
+
+        [[nodiscard]] size_t  count () const            { return _count; }
+        explicit operator bool () const                 { return _count > 0; }
+    };
+
+    // Suspend coroutine until required number of slots are free.
+    struct ReserveAwaiter
+    {
+        TaskSystem&     ts;
+        TaskPriority    lane;
+        size_t          count;
+
+        bool         await_ready ()     { return ts.try_acquire_slots( lane, count ); }
+        Reservation  await_resume ()    { return Reservation{ ts, lane, count }; }
+
+        template <typename P>
+        bool  await_suspend (std::coroutine_handle<P> curCoro)
+        {
+            static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
+
+            // slots will be acquired for the task when other tasks are complete
+            return ts.wait_slots( curCoro.promise().task(), lane, count );
+        }
+    };
+
+    // Called when task with deadline is completed after the deadline.
+    using DeadlineMissFn_t = std::function< void (AsyncTask &task, std::chrono::nanoseconds lateness) >;
+
+    // Move execution of the current coroutine to the task system.
+    struct ScheduleOnAwaiter
+    {
+        TaskSystem&     target;
+
+        bool  await_ready () const  { return TaskSystem::_current == &target; }
+        void  await_resume ()       {}
+
+        template <typename P>
+        bool  await_suspend (std::coroutine_handle<P> curCoro)
+        {
+            static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
+
+            // task will be added to the new system when current worker returns from 'run()',
+            // task leaves the strand, otherwise it would be added back to the strand
+            AsyncTask&  task = curCoro.promise().task();
+            task._system = &target;
+            task._strand = nullptr;
+            return true;  // suspend
+        }
+    };
+
+    // Move execution of the current coroutine to the main thread or to the specified worker.
+    struct SwitchToAwaiter
+    {
+        ThreadAffinity  target;
+
+        bool  await_ready () const  { return false; }
+        void  await_resume ()       {}
+
+        template <typename P>
+        bool  await_suspend (std::coroutine_handle<P> curCoro)
+        {
+            static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
+
+            AsyncTask&  task = curCoro.promise().task();
+            task._affinity = target;
+            task._strand   = nullptr;   // task leaves the strand
+
+            // resume if already in required thread
+            return not task._system->is_current_thread( target );
+        }
+    };
+
+    // Suspend coroutine and add it to the back of its lane without dependencies.
+    struct YieldAwaiter
+    {
+        bool    force;
+
+        bool  await_ready () const  { return not force and not TaskSystem::should_yield(); }
+        void  await_resume ()       {}
+
+        template <typename P>
+        bool  await_suspend (std::coroutine_handle<P>)
+        {
+            static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
+            return true;  // suspend
+        }
+    };
+
+private:
+    using Status = AsyncTask::Status;
+
+    static constexpr unsigned   LaneCount   = unsigned(TaskPriority::_Count);
+
+    // Coarsening, see 'set_coarsening()'.
+    static constexpr unsigned   MaxBatchSize    = 64;
+    static constexpr size_t     TypeTableSize   = 256;  // power of 2, types which do not fit are not measured
+    static constexpr size_t     MinTypeSamples  = 32;   // type is not fine-grained until it is measured enough times
+    static constexpr size_t     TypeWindow      = 128;  // recent histogram is halved when it has more samples
+    static constexpr size_t     MedianPeriod    = 16;   // median and classification are updated once per this number of samples
+    static constexpr unsigned   OutlierBuckets  = 3;    // sample which is 8 times longer than median is not used in moving average
+
+    // Task queue per worker thread, idle workers steal tasks from other queues.
+    // Tasks in 'pinned' can not be stolen.
+    // Tasks with deadline are stored in binary heap, the earliest deadline is on the top.
+    // 'next' is LIFO slot for the continuation which is readied by the worker, it can be stolen only
+    // after the owner has started another task, so the hot continuation does not migrate to another core.
+    struct alignas(64) WorkerQueue
+    {
+        using Queue_t = std::deque< RC<AsyncTask> >;
+        using Heap_t  = std::vector< RC<AsyncTask> >;
+
+        std::mutex      guard;
+        Heap_t          deadlines;
+        Queue_t         lanes [LaneCount];
+        Queue_t         pinned;
+        RC<AsyncTask>   next;
+        std::chrono::steady_clock::time_point   nextSince;  // start of consecutive runs from 'next', used only by the owner worker
+        unsigned        nextStamp   = 0;    // value of 'started' when 'next' is set
+        std::atomic<unsigned>   started {0};    // incremented by the owner worker before it selects a task
+
+        // Task which is executed by the worker, it is set only while sampling is enabled.
+        // Sampler locks 'runningGuard', so the task can not be released while sampler reads it.
+        std::mutex      runningGuard;
+        AsyncTask*      running     = nullptr;
+    };
+
+    std::unique_ptr< WorkerQueue[] >    _queues;
+    WorkerQueue                         _mainQueue;         // only 'lanes' are used
+    int                                 _queueCount = 0;
+    std::atomic<unsigned>               _nextQueue  {0};    // for tasks which are added outside of worker threads
+
+    // Approximate number of tasks in each lane, used to check if higher priority work is waiting.
+    std::atomic<int>                    _laneSize [LaneCount] = {};
+
+    std::atomic<int>                    _deadlineSize   {0};
+
+    std::atomic< int64_t >              _timeSliceNs    {1'000'000};
+
+    std::atomic<bool>                   _useNextSlot    {true};
+
+    // Workers publish running tasks for 'AwaitProfiler'.
+    std::atomic<int>                    _samplers       {0};
+
+    std::atomic< TaskRecorder* >        _recorder       {nullptr};
+
+    // Inline mode, see 'TaskSystem(0)'.
+    // '_inlineReady' is used only by the owner thread without lock,
+    // tasks which are readied by other threads are collected in '_remoteReady'.
+    bool                                _inline         = false;
+    std::thread::id                     _ownerThread;
+    WorkerQueue::Queue_t                _inlineReady;
+    uint32_t                            _inlineSeed     = 0;
+    std::mt19937                        _inlineRng;
+    std::mutex                          _remoteGuard;
+    WorkerQueue::Queue_t                _remoteReady;
+    std::atomic<int>                    _remoteCount    {0};
+
+    // Lock-free open addressing table of task types, entries are never removed.
+    struct TypeEntry
+    {
+        std::atomic< const void* >  key         {nullptr};
+        std::string                 name;                   // is set once by the thread which inserted the key
+        std::atomic<bool>           hasName     {false};
+        std::atomic<size_t>         count       {0};
+        std::atomic<size_t>         batched     {0};
+        std::atomic<size_t>         totalNs     {0};
+        std::atomic<uint32_t>       recentNs    {0};
+        std::atomic<unsigned>       median      {0};
+        std::atomic<bool>           fineGrained {false};
+        std::atomic<size_t>         histogram [TaskTypeStats::BucketCount] = {};
+        std::atomic<uint32_t>       window    [TaskTypeStats::BucketCount] = {};    // recent durations, old samples are forgotten
+    };
+    std::unique_ptr< TypeEntry[] >      _typeTable;
+
+    // Durations of tasks of one type, which are added to 'TypeEntry' at once.
+    struct TypeSamples
+    {
+        const void*     typeId      = nullptr;
+        TypeEntry*      type        = nullptr;
+        size_t          count       = 0;
+        int64_t         totalNs     = 0;
+        size_t          inliers     = 0;    // samples which are used in moving average
+        int64_t         inlierNs    = 0;
+        unsigned        maxInlier   = 0;    // the last bucket which is not an outlier, median is read once
+        uint32_t        histogram [TaskTypeStats::BucketCount] = {};
+    };
+
+    // Batch is executed by one thread, shared counters are updated once per batch instead of once per task.
+    struct BatchState
+    {
+        static constexpr size_t     MaxTypes    = 4;    // tasks of other types update their stats immediately
+
+        TypeSamples                             types [MaxTypes];
+        size_t                                  typeCount   = 0;
+        size_t                                  executed    = 0;
+        size_t                                  completed   = 0;
+        std::chrono::steady_clock::time_point   now;            // end of the previous task is the start of the next
+    };
+    std::atomic<bool>                   _coarsening         {false};
+    std::atomic< int64_t >              _coarseThresholdNs  {2'000};
+    std::atomic<unsigned>               _maxBatch           {16};
+    std::atomic<bool>                   _costBalancing      {false};
+
+    // Thief selects the most expensive task from the first tasks of the victim lane.
+    static constexpr size_t             MaxCostScan         = 32;
+
+    // Admission control, all tasks are counted, but only tasks which are added with reservation,
+    // by 'try_add()' or 'add_blocking()' are limited.
+    // Counters are atomic, so tasks are counted without lock, '_slotGuard' protects waiters and limits.
+    struct SlotWaiter
+    {
+        RC<AsyncTask>                           task;
+        TaskPriority                            lane;
+        size_t                                  count;
+        std::chrono::steady_clock::time_point   start;
+    };
+    std::mutex                          _slotGuard;
+    std::condition_variable             _slotCV;
+    std::deque< SlotWaiter >            _slotWaiters;       // FIFO of suspended coroutines
+    int                                 _blockedProducers   = 0;
+    std::atomic<int>                    _slotWaiting        {0};    // suspended and blocked producers, checked without lock
+    size_t                              _taskLimit          = ~size_t{0};
+    size_t                              _laneLimit [LaneCount];
+    size_t                              _queueLimit         = ~size_t{0};
+    size_t                              _laneQueueLimit [LaneCount];
+    std::atomic<size_t>                 _laneInFlight [LaneCount]   = {};
+    std::atomic<size_t>                 _laneQueued [LaneCount]     = {};
+
+    DeadlineMissFn_t                    _onDeadlineMiss;
+
+    std::vector< std::thread >      _threads;
+    std::atomic<bool>               _looping    {false};
+
+    // Idle workers sleep until new task is added or completed.
+    std::mutex                      _sleepGuard;
+    std::condition_variable         _sleepCV;
+    std::atomic<int>                _sleeping   {0};
+    std::atomic<unsigned>           _epoch      {0};
+
+    std::atomic< FrameArena* >      _frameArena {nullptr};
+
+    std::atomic<size_t>             _statAdded          {0};
+    std::atomic<size_t>             _statExecuted       {0};
+    std::atomic<size_t>             _statCompleted      {0};
+    std::atomic<size_t>             _statNextSlot       {0};
+    std::atomic<size_t>             _statRejected       {0};
+    std::atomic<size_t>             _statProducerWaitNs {0};
+    std::atomic<size_t>             _statDeadlineMissed {0};
+    std::atomic<size_t>             _statBatches        {0};
+    std::atomic<size_t>             _statBatchedTasks   {0};
+
+    // Index of worker thread, -1 for any other thread.
+    static inline thread_local int              _workerIndex    = -1;
+
+    // Task system which owns the worker thread.
+    static inline thread_local TaskSystem*      _current        = nullptr;
+
+    // Task system which is processed by 'process_main_thread()' in the current thread.
+    static inline thread_local TaskSystem*      _mainThreadOf   = nullptr;
+
+    // Task which is executed in the current thread and time when it is resumed.
+    static inline thread_local AsyncTask*       _runningTask    = nullptr;
+    static inline thread_local std::chrono::steady_clock::time_point    _sliceStart;
+
+    // Number of nested 'run_until()' calls in the current thread.
+    static inline thread_local int              _runUntilDepth  = 0;
+
+    // Each nested 'run_until()' keeps the caller stack alive, deeper calls execute only tasks which can not be executed
+    // by another thread: pinned to the current worker or added to the main thread queue.
+    static constexpr int                        MaxRunUntilDepth = 16;
+
+    static inline std::atomic< TaskSystem* >    _default        {nullptr};
+
+public:
+    // Install frame arena for all tasks which are created while the scope is active.
+    // All tasks must be complete and released before 'FrameArena::reset()'.
+    // Arena must not be shared between task systems, because worker chunks are indexed by worker index.
+    struct FrameArenaScope
+    {
+    private:
+        TaskSystem&     _ts;
+        FrameArena*     _prev;
+
+    public:
+        FrameArenaScope (TaskSystem &ts, FrameArena &arena) : _ts{ts}, _prev{ts._frameArena.exchange( &arena )} {}
+        ~FrameArenaScope ()                                  { _ts._frameArena.store( _prev ); }
+
+        FrameArenaScope (const FrameArenaScope &) = delete;
+        FrameArenaScope&  operator = (const FrameArenaScope &) = delete;
+    };
+
+public:
+    // Zero 'threadCount' creates inline task system without worker threads,
+    // tasks are executed in the thread which creates it by 'run_until()', 'process_main_thread()' and destructor.
+    // Order is deterministic, see 'set_inline_seed()', priorities, deadlines and affinities are ignored.
+    // Tasks can be added from other threads and other task systems.
+    explicit TaskSystem (int threadCount);
+    ~TaskSystem ();
+
+    TaskSystem (const TaskSystem &) = delete;
+    TaskSystem&  operator = (const TaskSystem &) = delete;
+
+    void  wait ();
+
+    // Execute tasks with 'ThreadAffinity::Main' until all of them are complete or time budget is spent.
+    // Returns number of executed tasks.
+    size_t  process_main_thread (std::chrono::nanoseconds timeBudget);
+
+    // Execute other tasks in the current thread until 'task' is complete.
+    // Can be called from any thread, including worker thread inside a task which is not a coroutine.
+    // Task is added to the task system if it is not added yet.
+    template <typename T>
+    T     run_until (Task<T> task);
+    void  run_until (RC<AsyncTask> task);
+
+    // Time which coroutine can run before 'maybe_yield()' suspends it.
+    void  set_time_slice (std::chrono::nanoseconds value)       { _timeSliceNs.store( value.count() ); }
+
+    [[nodiscard]] std::chrono::nanoseconds  time_slice () const { return std::chrono::nanoseconds{ _timeSliceNs.load( std::memory_order_relaxed )}; }
+
+    // Order of ready tasks in inline mode: 0 - FIFO, otherwise each task is selected from the ready tasks
+    // by pseudo-random generator, the same seed reproduces the same order. Must be set before tasks are added.
+    void  set_inline_seed (uint32_t seed)                       { _inlineSeed = seed;  _inlineRng.seed( seed ); }
+
+    [[nodiscard]] bool  is_inline () const                      { return _inline; }
+
+    // Enable or disable LIFO slot for continuations, enabled by default.
+    // Consecutive runs from the slot are limited by the time slice, then the worker takes task from the lanes.
+    void  set_next_slot (bool enabled)                          { _useNextSlot.store( enabled ); }
+
+    // Measure duration of tasks per type, when median duration of the type is less than 'threshold',
+    // ready tasks of this type are extracted from the queue or stolen in batches of up to 'maxBatch' tasks
+    // and executed back-to-back by one worker. Batch saves the queue lock and updates of shared counters,
+    // status changes, dependencies and reference counting are still done per task. Disabled by default.
+    void  set_coarsening (bool enabled, std::chrono::nanoseconds threshold = std::chrono::microseconds{2}, unsigned maxBatch = 16);
+
+    // Estimate cost of tasks by hints or by recent durations of tasks of the same type.
+    // Idle workers steal the most expensive task instead of the oldest one,
+    // batch of tasks is split between workers by cost, the longest tasks are executed first.
+    // Disabled by default.
+    void  set_cost_balancing (bool enabled)                     { _costBalancing.store( enabled ); }
+
+    // Returns stats of task types sorted by number of executions.
+    [[nodiscard]] std::vector< TaskTypeStats >  type_stats () const;
+    [[nodiscard]] std::string                   type_stats_text (size_t maxEntries = 10) const;
+
+    // Must not be called while tasks are executed.
+    void  reset_type_stats ();
+
+    // Limit number of tasks which are added and not complete yet (in flight), for all lanes or per lane.
+    // Suspended coroutines are in flight, so the limit bounds memory of coroutine frames.
+    void  set_task_limit (size_t value);
+    void  set_task_limit (TaskPriority lane, size_t value);
+
+    // Limit number of tasks in the queues, which are waiting for a worker, for all lanes or per lane.
+    void  set_queue_limit (size_t value);
+    void  set_queue_limit (TaskPriority lane, size_t value);
+
+    // Limits are applied by 'reserve()', 'try_add()' and 'add_blocking()'.
+    // Plain 'add()', bulk 'add()' and tasks which are scheduled by 'co_await' are counted, but never wait or fail:
+    // they are unlimited bypass for nested work, otherwise a task which waits for its children can deadlock.
+
+    // Acquire slots for 'count' tasks, coroutine is suspended until slots are free.
+    // Usage: 'auto r = co_await ts.reserve( n );  ts.add( task, r );'
+    [[nodiscard]] ReserveAwaiter  reserve (size_t count, TaskPriority lane = TaskPriority::Normal)  { return ReserveAwaiter{ *this, lane, count }; }
+
+    // Recorder receives events of all tasks, 'nullptr' disables recording.
+    // Recorder must not be changed while tasks are executed.
+    void  set_recorder (TaskRecorder* value)                    { _recorder.store( value ); }
+
+    [[nodiscard]] TaskRecorder*  recorder () const              { return _recorder.load( std::memory_order_relaxed ); }
+
+    // Must be set before tasks with deadline are added.
+    void  set_deadline_miss_handler (DeadlineMissFn_t fn)     { _onDeadlineMiss = std::move(fn); }
+
+    [[nodiscard]] Stats        stats ()         const;
+    [[nodiscard]] FrameArena*  frame_arena ()   const   { return _frameArena.load( std::memory_order_relaxed ); }
+    [[nodiscard]] static int   worker_index ()          { return _workerIndex; }
+
+    // Slot of the frame arena for the current thread, only the worker of this system uses its own slot,
+    // any other thread, for example worker of another system in 'run_until()', uses the locked slot 0.
+    [[nodiscard]] int  frame_arena_slot () const        { return _current == this ? _workerIndex + 1 : 0; }
+
+    // Returns task system which executes the current task, task system which owns the current worker thread,
+    // or the default instance for any other thread.
+    [[nodiscard]] static TaskSystem*  current ();
+    
+    template <typename T>
+    void  add (Task<T> task);
+    void  add (RC<AsyncTask> task);
+
+    template <typename T>
+    void  add (Task<T> task, TaskPriority priority);
+
+    template <typename T>
+    void  add (Task<T> task, AsyncTask::TimePoint_t deadline);
+
+    template <typename T>
+    void  add (Task<T> task, TaskCost cost);
+
+    void  add (std::span< RC<AsyncTask> > tasks);
+
+    template <typename Range>
+        requires( IsTask< std::ranges::range_value_t< Range >>)
+    void  add (Range &&tasks);
+
+    // Add callable object as a task without coroutine frame.
+    template <typename Fn>
+        requires( std::is_invocable_v< Fn >)
+    auto  add (Fn &&fn);
+
+    // Add task using one slot from reservation, task gets priority of the reservation.
+    template <typename T>
+    void  add (Task<T> task, Reservation &res);
+
+    // Add task if there is a free slot, otherwise returns 'false'.
+    template <typename T>
+    bool  try_add (Task<T> task, TaskPriority lane = TaskPriority::Normal);
+
+    // Block the current thread until there is a free slot, must not be called from worker thread.
+    template <typename T>
+    void  add_blocking (Task<T> task, TaskPriority lane = TaskPriority::Normal);
+
+    static TaskSystem&  instance ();
+    static TaskSystem&  create (int threadCount);
+    static void         destroy ();
+
+private:
+    void  stop ();
+    void  init_threads (int count);
+    bool  process_tasks (int worker);
+    bool  process_any_task (bool mainThread);
+    bool  process_pinned_task (int worker, bool mainThread);
+    void  enqueue (RC<AsyncTask> task);
+    void  enqueue_inline (RC<AsyncTask> task);
+    bool  process_inline ();
+    void  requeue (RC<AsyncTask> task);
+    void  requeue_continuation (RC<AsyncTask> task);
+    void  wake_workers (size_t count);
+    void  sleep (unsigned epoch);
+
+    [[nodiscard]] size_t         select_queue ();
+    [[nodiscard]] bool           has_tasks ();
+    [[nodiscard]] bool           is_current_thread (ThreadAffinity affinity) const;
+    [[nodiscard]] RC<AsyncTask>  extract_task (WorkerQueue &q, WorkerQueue::Queue_t &tasks);
+    [[nodiscard]] RC<AsyncTask>  extract_task (int worker, unsigned lane);
+    [[nodiscard]] RC<AsyncTask>  extract_costly_task (WorkerQueue &q, WorkerQueue::Queue_t &tasks);
+    [[nodiscard]] RC<AsyncTask>  extract_deadline_task (WorkerQueue &q);
+    [[nodiscard]] RC<AsyncTask>  extract_deadline_task (int worker);
+    [[nodiscard]] RC<AsyncTask>  extract_next_task (WorkerQueue &q, bool steal);
+    [[nodiscard]] RC<AsyncTask>  steal_next_task (int worker);
+
+    bool  process_batch (int worker, unsigned lane);
+    [[nodiscard]] size_t      extract_batch (WorkerQueue &q, unsigned lane, bool steal, RC<AsyncTask>* out, size_t maxCount);
+    [[nodiscard]] TypeEntry*  find_type (const AsyncTask &task, bool insert);
+    [[nodiscard]] TypeEntry*  fine_grained_type (const AsyncTask &task);
+    [[nodiscard]] static TypeSamples  begin_samples (TypeEntry &type, const void* typeId);
+    [[nodiscard]] TypeSamples*  batch_samples (BatchState &batch, const AsyncTask &task);
+    static void  add_sample (TypeSamples &samples, int64_t durationNs);
+    void  update_type (const TypeSamples &samples);
+
+    [[nodiscard]] int64_t  estimated_cost (const AsyncTask &task);
+    void  balance_by_cost (std::span< RC<AsyncTask> > tasks, size_t parts, std::vector<uint32_t> &order, std::vector<size_t> &bounds);
+
+    [[nodiscard]] static bool    earlier_deadline (const RC<AsyncTask> &lhs, const RC<AsyncTask> &rhs);
+    [[nodiscard]] static bool    should_yield ();
+
+    void  execute (RC<AsyncTask> t, BatchState* batch = nullptr);
+
+    [[nodiscard]] bool  has_slots (TaskPriority lane, size_t count) const;
+    [[nodiscard]] bool  try_acquire_slots (TaskPriority lane, size_t count);
+    [[nodiscard]] bool  wait_slots (AsyncTask &task, TaskPriority lane, size_t count);
+    void  acquire_slots (TaskPriority lane, size_t count);
+    void  release_slots (TaskPriority lane, size_t queued, size_t inFlight);
+    void  pass_slots ();
+    void  count_enqueued (AsyncTask &task);
+    void  add_admitted (RC<AsyncTask> task, TaskPriority lane);
+};
+
+
+// Selects inline or parallel task system for a call site by estimated duration of the work.
+// When the work is smaller than 'threshold' it is cheaper to execute it in the current thread
+// than to distribute it between workers. Duration per item is learned from inline runs,
+// until it is measured the work is executed inline.
+// Usage:
+//      static InlineHeuristic  site;
+//      TaskSystem&  ts = site.select( items, inlineTs, parallelTs );
+//      ... ts.run_until( ... );
+//      site.record( ts, items, elapsed );
+struct InlineHeuristic
+{
+private:
+    const int64_t               _thresholdNs;
+    std::atomic< int64_t >      _nsPerItem  {0};    // 0 - not measured
+
+public:
+    explicit InlineHeuristic (std::chrono::nanoseconds threshold = std::chrono::microseconds{100}) : _thresholdNs{threshold.count()} {}
+
+    [[nodiscard]] bool  should_inline (size_t items) const
+    {
+        const int64_t   perItem = _nsPerItem.load( std::memory_order_relaxed );
+        return perItem == 0 or int64_t(items) * perItem < _thresholdNs;
+    }
+
+    [[nodiscard]] TaskSystem&  select (size_t items, TaskSystem &inlineTs, TaskSystem &parallelTs) const
+    {
+        assert( inlineTs.is_inline() );
+        return should_inline( items ) ? inlineTs : parallelTs;
+    }
+
+    // Only inline runs are measured, duration of parallel run depends on number of free workers.
+    void  record (const TaskSystem &ts, size_t items, std::chrono::nanoseconds elapsed)
+    {
+        if ( not ts.is_inline() or items == 0 )
+            return;
+
+        const int64_t   perItem = std::max( elapsed.count() / int64_t(items), int64_t{1} );
+        const int64_t   prev    = _nsPerItem.load( std::memory_order_relaxed );
+
+        _nsPerItem.store( prev == 0 ? perItem : (prev * 3 + perItem) / 4, std::memory_order_relaxed );
+    }
+
+    [[nodiscard]] std::chrono::nanoseconds  estimate (size_t items) const
+    {
+        return std::chrono::nanoseconds{ int64_t(items) * _nsPerItem.load( std::memory_order_relaxed )};
+    }
+};
+
+
+// Serial executor, tasks are executed one at a time in FIFO order on any free worker, without mutex.
+// Coroutine is executed by the strand until it is complete or until it is moved by 'switch_to()' or 'schedule_on()',
+// code between suspension points of different coroutines in the same strand is never executed concurrently.
+// Idle strand has no tasks in the task system. Strand must outlive all its tasks.
+struct Strand
+{
+    friend struct TaskSystem;
+
+public:
+    // Move execution of the current coroutine to the strand.
+    struct ScheduleAwaiter
+    {
+        Strand&     target;
+
+        bool  await_ready () const  { return false; }
+        void  await_resume ()       {}
+
+        template <typename P>
+        bool  await_suspend (std::coroutine_handle<P> curCoro)
+        {
+            static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
+
+            // task will be added to the strand when current worker returns from 'run()'
+            curCoro.promise().task()._strand = &target;
+            return true;  // suspend
+        }
+    };
+
+private:
+    TaskSystem&                 _ts;
+
+    // Lock-free MPSC queue: producers push to the stack, the single consumer takes the whole stack.
+    std::atomic< AsyncTask* >   _head       {nullptr};
+
+    // Number of tasks in the queue, the first task schedules the drain.
+    std::atomic<int>            _pending    {0};
+
+public:
+    explicit Strand (TaskSystem &ts) : _ts{ts} {}
+    ~Strand ()                                  { assert( _pending.load() == 0 ); }
+
+    Strand (const Strand &) = delete;
+    Strand&  operator = (const Strand &) = delete;
+
+    template <typename T>
+    void  add (Task<T> task);
+    void  add (RC<AsyncTask> task);
+
+    // Add callable object as a task without coroutine frame.
+    template <typename Fn>
+        requires( std::is_invocable_v< Fn >)
+    auto  add (Fn &&fn);
+
+    [[nodiscard]] ScheduleAwaiter   schedule ()         { return ScheduleAwaiter{ *this }; }
+    [[nodiscard]] TaskSystem&       task_system () const{ return _ts; }
+
+private:
+    void  push (RC<AsyncTask> task);
+    void  drain ();
+};
+
+
+// Resumes long-lived coroutines once per tick, coroutine frames are reused across ticks.
+// Coroutine loops on 'co_await next_tick(clock)', the awaiter returns 'false' when the clock is stopped.
+// Task is resumed when all its dependencies have finished the current tick,
+// dependencies are set once in 'add()' and kept for all ticks.
+// Steady-state ticking does not allocate task memory.
+struct TickClock
+{
+public:
+    struct TickAwaiter
+    {
+        TickClock&  clock;
+
+        bool  await_ready () const  { return false; }
+        bool  await_resume ()       { return not clock._stopped.load(); }
+
+        template <typename P>
+        bool  await_suspend (std::coroutine_handle<P> curCoro)
+        {
+            static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
+            return clock.on_tick_end( curCoro.promise().task() );
+        }
+    };
+
+private:
+    struct Entry
+    {
+        AsyncTask*              task            = nullptr;
+        RC<AsyncTask>           suspended;              // task which waits for the next tick
+        std::vector<uint32_t>   dependents;             // entries which are resumed after this entry
+        uint32_t                depCount        = 0;
+        uint32_t                remaining       = 0;    // dependencies which have not finished the current tick
+        uint64_t                startedTick     = 0;
+        uint64_t                finishedTick    = 0;
+    };
+
+    std::mutex              _guard;
+    std::vector< Entry >    _entries;
+    uint64_t                _tick       = 0;
+    size_t                  _finished   = 0;    // number of entries which have finished the current tick
+    std::atomic<bool>       _stopped    {false};    // written under '_guard', read without lock in 'TickAwaiter'
+
+public:
+    TickClock () {}
+    ~TickClock ()                               { assert( _stopped or _entries.empty() ); }
+
+    TickClock (const TickClock &) = delete;
+    TickClock&  operator = (const TickClock &) = delete;
+
+    // Register recurring task and add it to the task system, dependencies must be registered before.
+    // Must not be called while tick is in progress.
+    template <typename T, typename ...Deps>
+    void  add (TaskSystem &ts, Task<T> task, const Task<Deps>& ...deps);
+
+    // Start new tick, returns 'false' if the previous tick is not finished yet.
+    bool  tick ();
+
+    // Resume all tasks, 'next_tick()' returns 'false' and coroutines can complete.
+    void  stop ();
+
+    [[nodiscard]] bool      is_tick_finished ();
+    [[nodiscard]] uint64_t  tick_index ();
+
+private:
+    [[nodiscard]] bool  on_tick_end (AsyncTask &task);
+    [[nodiscard]] bool  is_finished () const    { return _finished == _entries.size(); }
+    [[nodiscard]] size_t  find (const AsyncTask* task) const;
+    void  try_start (Entry &e);
+};
+
+// Suspend recurring coroutine until the next tick.
+[[nodiscard]] inline TickClock::TickAwaiter  next_tick (TickClock &clock)
+{
+    return TickClock::TickAwaiter{ clock };
+}
+
+
+// Used placement new to avoid false positive warning on memleak
+inline TaskSystem&  TaskSystem::instance ()
+{
+    static std::aligned_storage_t< sizeof(TaskSystem), alignof(TaskSystem) >   ts;
+    return *static_cast<TaskSystem *>( static_cast<void*>( &ts ));
+}
+
+inline TaskSystem&  TaskSystem::create (int threadCount)
+{
+    auto* ts = new(&instance()) TaskSystem{ threadCount };
+    _default.store( ts );
+    return *ts;
+}
+
+inline void  TaskSystem::destroy ()
+{
+    _default.store( nullptr );
+    instance().~TaskSystem();
+}
+
+inline TaskSystem*  TaskSystem::current ()
+{
+    // task can be executed by another thread in 'run_until()' or 'process_main_thread()'
+    if ( _runningTask != nullptr )
+        return _runningTask->_system;
+
+    return _current != nullptr ? _current : _default.load();
+}
+
+
+inline TaskSystem::TaskSystem (int threadCount)
+{
+    std::fill( std::begin(_laneLimit), std::end(_laneLimit), ~size_t{0} );
+    std::fill( std::begin(_laneQueueLimit), std::end(_laneQueueLimit), ~size_t{0} );
+    _typeTable.reset( new TypeEntry [TypeTableSize] );
+    init_threads( threadCount );
+}
+
+inline TaskSystem::~TaskSystem ()
+{
+    stop();
+}
+
+
+inline TaskSystem::Stats  TaskSystem::stats () const
+{
+    Stats   result;
+    result.added            = _statAdded.load();
+    result.executed         = _statExecuted.load();
+    result.completed        = _statCompleted.load();
+    result.nextSlot         = _statNextSlot.load();
+    result.rejected         = _statRejected.load();
+    result.producerWaitNs   = _statProducerWaitNs.load();
+    result.deadlineMissed   = _statDeadlineMissed.load();
+    result.batches          = _statBatches.load();
+    result.batchedTasks     = _statBatchedTasks.load();
+
+    for (unsigned lane = 0; lane < LaneCount; ++lane)
+    {
+        result.queued   += _laneQueued[lane].load();
+        result.inFlight += _laneInFlight[lane].load();
+    }
+    return result;
+}
+
+
+// Move execution of the current coroutine to another task system.
+[[nodiscard]] inline TaskSystem::ScheduleOnAwaiter  schedule_on (TaskSystem &ts)
+{
+    return TaskSystem::ScheduleOnAwaiter{ ts };
+}
+
+// Move execution of the current coroutine to the main thread or back to any worker thread.
+[[nodiscard]] inline TaskSystem::SwitchToAwaiter  switch_to (ThreadAffinity affinity)
+{
+    return TaskSystem::SwitchToAwaiter{ affinity };
+}
+
+// Move execution of the current coroutine to the specified worker thread.
+[[nodiscard]] inline TaskSystem::SwitchToAwaiter  switch_to (WorkerIndex worker)
+{
+    assert( worker.value >= 0 );
+    return TaskSystem::SwitchToAwaiter{ ThreadAffinity(worker.value) };
+}
+
+// Always suspend the current coroutine and add it to the back of its lane.
+[[nodiscard]] inline TaskSystem::YieldAwaiter  yield_now ()
+{
+    return TaskSystem::YieldAwaiter{ true };
+}
+
+// Suspend the current coroutine only if its time slice is over or higher priority task is waiting.
+[[nodiscard]] inline TaskSystem::YieldAwaiter  maybe_yield ()
+{
+    return TaskSystem::YieldAwaiter{ false };
+}
+
+
+// Counters are per thread, only the owner thread writes them, so allocation does not touch a shared cache line.
+// Thread moves its live bytes to the global counter when they change by 'FlushSize' and at thread exit,
+// so peak may be missed by up to 'FlushSize' bytes per thread.
+struct TaskMemoryCounters
+{
+    static constexpr int64_t    FlushSize   = 4 << 10;
+
+    struct Local
+    {
+        std::atomic<int64_t>    live    {0};    // not moved to the global counter yet, negative if memory was allocated by another thread
+        std::atomic<uint64_t>   total   {0};
+        Local*                  next    = nullptr;
+
+        Local ()
+        {
+            std::unique_lock    lock{ guard };
+            next    = threads;
+            threads = this;
+        }
+
+        ~Local ()
+        {
+            std::unique_lock    lock{ guard };
+            Flush( *this, live.load( std::memory_order_relaxed ));
+            exitedTotal += total.load( std::memory_order_relaxed );
+
+            for (Local** it = &threads; *it != nullptr; it = &(*it)->next)
+            {
+                if ( *it == this ) {
+                    *it = next;
+                    break;
+                }
+            }
+        }
+    };
+
+    static inline std::mutex            guard;
+    static inline Local*                threads     = nullptr;  // protected by 'guard'
+    static inline uint64_t              exitedTotal = 0;        // protected by 'guard'
+    static inline uint64_t              totalBase   = 0;        // protected by 'guard'
+    static inline std::atomic<int64_t>  live        {0};
+    static inline std::atomic<int64_t>  peak        {0};
+    static thread_local Local           local;
+
+    static void  OnAllocate (size_t size)
+    {
+        Local&  l = local;
+        l.total.store( l.total.load( std::memory_order_relaxed ) + size, std::memory_order_relaxed );
+
+        const int64_t   delta = l.live.load( std::memory_order_relaxed ) + int64_t(size);
+        if ( delta >= FlushSize )
+            Flush( l, delta );
+        else
+            l.live.store( delta, std::memory_order_relaxed );
+    }
+
+    static void  OnDeallocate (size_t size)
+    {
+        Local&          l       = local;
+        const int64_t   delta   = l.live.load( std::memory_order_relaxed ) - int64_t(size);
+        if ( delta <= -FlushSize )
+            Flush( l, delta );
+        else
+            l.live.store( delta, std::memory_order_relaxed );
+    }
+
+    static void  Flush (Local &l, int64_t delta)
+    {
+        l.live.store( 0, std::memory_order_relaxed );
+        UpdatePeak( live.fetch_add( delta, std::memory_order_relaxed ) + delta );
+    }
+
+    static void  UpdatePeak (int64_t cur)
+    {
+        for (int64_t p = peak.load( std::memory_order_relaxed );
+             p < cur and not peak.compare_exchange_weak( p, cur, std::memory_order_relaxed );)
+        {}
+    }
+
+    // Sum of all threads, 'guard' must be locked.
+    static void  Sum (int64_t &liveSum, uint64_t &totalSum)
+    {
+        liveSum     = live.load( std::memory_order_relaxed );
+        totalSum    = exitedTotal;
+        for (Local* l = threads; l != nullptr; l = l->next)
+        {
+            liveSum     += l->live.load( std::memory_order_relaxed );
+            totalSum    += l->total.load( std::memory_order_relaxed );
+        }
+    }
+};
+
+inline thread_local TaskMemoryCounters::Local  TaskMemoryCounters::local;
+
+inline void*  allocate_task_memory (size_t size)
+{
+    TaskMemoryCounters::OnAllocate( size );
+
+    // arena and slot are taken from the same task system
+    TaskSystem*     ts = TaskSystem::current();
+    return ts != nullptr ? FrameArena::Allocate( ts->frame_arena(), size, ts->frame_arena_slot() ) : ::operator new( size );
+}
+
+inline void  deallocate_task_memory (void* ptr, size_t size)
+{
+    if ( ptr == nullptr )
+        return;
+
+    TaskMemoryCounters::OnDeallocate( size );
+    FrameArena::Deallocate( ptr );
+}
+
+inline void*  allocate_task_heap_memory (size_t size)
+{
+    TaskMemoryCounters::OnAllocate( size );
+    return ::operator new( size );
+}
+
+inline void  deallocate_task_heap_memory (void* ptr, size_t size)
+{
+    if ( ptr == nullptr )
+        return;
+
+    TaskMemoryCounters::OnDeallocate( size );
+    ::operator delete( ptr );
+}
+
+inline void*  TaskPool::Allocate (size_t size)
+{
+    TaskMemoryCounters::OnAllocate( size );
+
+    const size_t    cls = _Class( size );
+    if ( cls >= ClassCount )
+        return ::operator new( size );
+
+    auto&   list = _lists[cls];
+    if ( Block* b = list.head )
+    {
+        list.head = b->next;
+        --list.count;
+        return b;
+    }
+    return ::operator new( (cls + 1) * Granularity );
+}
+
+inline void  TaskPool::Deallocate (void* ptr, size_t size)
+{
+    if ( ptr == nullptr )
+        return;
+
+    TaskMemoryCounters::OnDeallocate( size );
+
+    const size_t    cls = _Class( size );
+    if ( cls >= ClassCount or _lists[cls].count >= MaxFree )
+        return ::operator delete( ptr );
+
+    auto&   list    = _lists[cls];
+    auto*   b       = static_cast< Block* >( ptr );
+    b->next     = list.head;
+    list.head   = b;
+    ++list.count;
+}
+
+inline TaskPool::FreeList::~FreeList ()
+{
+    for (; head != nullptr;) {
+        ::operator delete( std::exchange( head, head->next ));
+    }
+}
+
+
+inline TaskMemoryStats  task_memory_stats ()
+{
+    using C = TaskMemoryCounters;
+
+    std::unique_lock    lock{ C::guard };
+    int64_t             live;
+    uint64_t            total;
+    C::Sum( live, total );
+    C::UpdatePeak( live );
+
+    TaskMemoryStats     result;
+    result.liveBytes    = size_t(std::max( live, int64_t{0} ));
+    result.peakBytes    = size_t(C::peak.load( std::memory_order_relaxed ));
+    result.totalBytes   = size_t(total - C::totalBase);
+    return result;
+}
+
+inline void  reset_task_memory_peak ()
+{
+    using C = TaskMemoryCounters;
+
+    std::unique_lock    lock{ C::guard };
+    int64_t             live;
+    uint64_t            total;
+    C::Sum( live, total );
+
+    C::peak.store( std::max( live, int64_t{0} ), std::memory_order_relaxed );
+    C::totalBase = total;
+}
+
+
+// Add task/coroutine to the queue.
+template <typename T>
+inline void  TaskSystem::add (Task<T> task)
+{
+    return add( RC<AsyncTask>{ task.to_async_task() });
+}
+
+template <typename T>
+inline void  TaskSystem::add (Task<T> task, TaskPriority priority)
+{
+    assert( priority < TaskPriority::_Count );
+    task.to_async_task()->_priority = priority;
+
+    return add( RC<AsyncTask>{ task.to_async_task() });
+}
+
+template <typename T>
+inline void  TaskSystem::add (Task<T> task, AsyncTask::TimePoint_t deadline)
+{
+    task.to_async_task()->_deadline = deadline;
+
+    return add( RC<AsyncTask>{ task.to_async_task() });
+}
+
+template <typename T>
+inline void  TaskSystem::add (Task<T> task, TaskCost cost)
+{
+    task.to_async_task()->set_cost_hint( cost );
+
+    return add( RC<AsyncTask>{ task.to_async_task() });
+}
+
+// Task which is already added directly or by 'co_await' is ignored.
+inline void  TaskSystem::add (RC<AsyncTask> task)
+{
+    assert( task );
+
+    Status  expected = Status::Initial;
+    if ( not task->_status.compare_exchange_strong( expected, Status::InQueue ))
+        return;
+
+    enqueue( std::move(task) );
+}
+
+
+// Add suspended task back to the queue when all its dependencies are complete.
+inline void  TaskSystem::requeue (RC<AsyncTask> task)
+{
+    Status  stat = task->_status.exchange( Status::InQueue );
+    assert( stat == Status::InProgress );
+    (void)(stat);
+
+    enqueue( std::move(task) );
+}
+
+
+// Add task which is unblocked by the task which is completed in the current thread.
+// If the current thread is a worker then the task is placed into its LIFO slot and executed next,
+// while the result of the dependency is still in cache. Previous task from the slot is moved to the lane.
+inline void  TaskSystem::requeue_continuation (RC<AsyncTask> task)
+{
+    if ( _current != this                                   or
+         not _useNextSlot.load( std::memory_order_relaxed ) or
+         task->_affinity != ThreadAffinity::Any             or
+         task->_strand != nullptr                           or
+         task->_deadline != AsyncTask::TimePoint_t::max() )
+        return requeue( std::move(task) );
+
+    Status  stat = task->_status.exchange( Status::InQueue );
+    assert( stat == Status::InProgress );
+    (void)(stat);
+
+    task->_system = this;
+    _statAdded.fetch_add( 1, std::memory_order_relaxed );
+    count_enqueued( *task );
+
+    if ( TaskRecorder* rec = recorder() )
+        rec->on_ready( *task, std::chrono::steady_clock::now() );
+
+    unsigned    lane;
+    {
+        auto&               q = _queues[ _workerIndex ];
+        std::scoped_lock    lock {q.guard};
+        std::swap( task, q.next );
+        q.nextStamp = q.started.load( std::memory_order_relaxed );
+
+        if ( not task )
+            return;
+
+        lane = unsigned(task->_priority);
+        q.lanes[lane].push_back( std::move(task) );
+    }
+
+    _laneSize[lane].fetch_add( 1 );
+    wake_workers( 1 );
+}
+
+
+// Add task which is ready to be executed.
+inline void  TaskSystem::enqueue (RC<AsyncTask> task)
+{
+    assert( task->_status.load() == Status::InQueue );
+
+    task->_system = this;
+    _statAdded.fetch_add( 1, std::memory_order_relaxed );
+    count_enqueued( *task );
+
+    if ( TaskRecorder* rec = recorder() )
+        rec->on_ready( *task, std::chrono::steady_clock::now() );
+
+    if ( task->_strand != nullptr )
+        return task->_strand->push( std::move(task) );
+
+    if ( _inline )
+        return enqueue_inline( std::move(task) );
+
+    const ThreadAffinity    affinity    = task->_affinity;
+    const unsigned          lane        = unsigned(task->_priority);
+
+    if ( affinity == ThreadAffinity::Main )
+    {
+        std::scoped_lock    lock {_mainQueue.guard};
+        _mainQueue.lanes[lane].push_back( std::move(task) );
+        return;
+    }
+
+    if ( affinity != ThreadAffinity::Any )
+    {
+        {
+            auto&               q = _queues[ size_t(affinity) % _queueCount ];
+            std::scoped_lock    lock {q.guard};
+            q.pinned.push_back( std::move(task) );
+        }
+        // can not wake specified worker
+        wake_workers( _queueCount );
+        return;
+    }
+
+    if ( task->_deadline != AsyncTask::TimePoint_t::max() )
+    {
+        {
+            auto&               q = _queues[ select_queue() ];
+            std::scoped_lock    lock {q.guard};
+            q.deadlines.push_back( std::move(task) );
+            std::push_heap( q.deadlines.begin(), q.deadlines.end(), &earlier_deadline );
+        }
+        _deadlineSize.fetch_add( 1 );
+        wake_workers( 1 );
+        return;
+    }
+
+    {
+        auto&               q = _queues[ select_queue() ];
+        std::scoped_lock    lock {q.guard};
+        q.lanes[lane].push_back( std::move(task) );
+    }
+    _laneSize[lane].fetch_add( 1 );
+    wake_workers( 1 );
+}
+
+
+// Inline mode: task which is readied by the owner thread is added without lock.
+inline void  TaskSystem::enqueue_inline (RC<AsyncTask> task)
+{
+    if ( std::this_thread::get_id() == _ownerThread )
+    {
+        _inlineReady.push_back( std::move(task) );
+        return;
+    }
+
+    std::scoped_lock    lock {_remoteGuard};
+    _remoteReady.push_back( std::move(task) );
+    _remoteCount.fetch_add( 1 );
+}
+
+
+// Inline mode: execute one ready task in the owner thread, returns 'false' if there are no ready tasks.
+inline bool  TaskSystem::process_inline ()
+{
+    assert( std::this_thread::get_id() == _ownerThread );
+
+    if ( _remoteCount.load( std::memory_order_relaxed ) > 0 )
+    {
+        std::scoped_lock    lock {_remoteGuard};
+        for (auto& t : _remoteReady) {
+            _inlineReady.push_back( std::move(t) );
+        }
+        _remoteReady.clear();
+        _remoteCount.store( 0 );
+    }
+
+    if ( _inlineReady.empty() )
+        return false;
+
+    // 'mt19937' output is the same on all platforms, unlike distributions, so the order is reproducible by the seed
+    if ( _inlineSeed != 0 )
+        std::swap( _inlineReady.front(), _inlineReady[ size_t(_inlineRng() % _inlineReady.size()) ]);
+
+    RC<AsyncTask>   t = std::move( _inlineReady.front() );
+    _inlineReady.pop_front();
+
+    Status  stat = t->_status.exchange( Status::InProgress );
+    assert( stat == Status::InQueue );
+    (void)(stat);
+
+    execute( std::move(t) );
+    return true;
+}
+
+
+// Add batch of tasks.
+// Batch is split between worker queues, each queue is locked once and workers are woken once.
+// Queue space is not reserved, lanes are 'std::deque' which grows by blocks without moving tasks.
+inline void  TaskSystem::add (std::span< RC<AsyncTask> > tasks)
+{
+    if ( tasks.empty() )
+        return;
+
+    if ( _inline )
+    {
+        for (auto& t : tasks) {
+            add( t );
+        }
+        return;
+    }
+
+    // tasks with thread affinity and strand tasks are added one by one to their queues
+    const auto  IsGeneral = [] (const RC<AsyncTask> &t) { assert( t );  return t->_affinity == ThreadAffinity::Any and t->_strand == nullptr; };
+
+    if ( not std::ranges::all_of( tasks, IsGeneral ))
+    {
+        std::vector< RC<AsyncTask> >    general;
+        general.reserve( tasks.size() );
+
+        for (auto& t : tasks)
+        {
+            if ( IsGeneral( t ))
+                general.push_back( t );
+            else
+                add( t );
+        }
+        return add( std::span{ general });
+    }
+
+    const size_t    parts   = std::min( size_t(_queueCount), tasks.size() );
+    const size_t    first   = select_queue();
+
+    int     laneSize [LaneCount]    = {};
+    int     deadlineSize            = 0;
+    size_t  added                   = 0;
+    auto    now                     = std::chrono::steady_clock::now();
+    auto*   rec                     = recorder();
+
+    // by default batch is split by number of tasks
+    std::vector<uint32_t>   order;
+    std::vector<size_t>     bounds;
+
+    if ( parts > 1 and _costBalancing.load( std::memory_order_relaxed ))
+        balance_by_cost( tasks, parts, order, bounds );
+
+    for (size_t p = 0; p < parts; ++p)
+    {
+        const size_t        begin   = order.empty() ? tasks.size() * p / parts     : bounds[p];
+        const size_t        end     = order.empty() ? tasks.size() * (p+1) / parts : bounds[p+1];
+        auto&               q       = _queues[ (first + p) % _queueCount ];
+        std::scoped_lock    lock {q.guard};
+
+        for (size_t j = begin; j < end; ++j)
+        {
+            const size_t    i = order.empty() ? j : order[j];
+
+            // skip task which is already added
+            Status  expected = Status::Initial;
+            if ( not tasks[i]->_status.compare_exchange_strong( expected, Status::InQueue ))
+                continue;
+
+            tasks[i]->_system = this;
+            ++added;
+
+            // counted before the queue is unlocked, so the task can not be executed before it is counted
+            count_enqueued( *tasks[i] );
+
+            if ( rec != nullptr )
+                rec->on_ready( *tasks[i], now );
+
+            if ( tasks[i]->_deadline != AsyncTask::TimePoint_t::max() )
+            {
+                q.deadlines.push_back( tasks[i] );
+                std::push_heap( q.deadlines.begin(), q.deadlines.end(), &earlier_deadline );
+                ++deadlineSize;
+                continue;
+            }
+
+            const unsigned  lane = unsigned(tasks[i]->_priority);
+            q.lanes[lane].push_back( tasks[i] );
+            ++laneSize[lane];
+        }
+    }
+
+    for (unsigned lane = 0; lane < LaneCount; ++lane) {
+        _laneSize[lane].fetch_add( laneSize[lane] );
+    }
+    _deadlineSize.fetch_add( deadlineSize );
+    _statAdded.fetch_add( added, std::memory_order_relaxed );
+
+    // don't wake more workers than the number of tasks
+    wake_workers( added );
+}
+
+template <typename Range>
+    requires( IsTask< std::ranges::range_value_t< Range >>)
+inline void  TaskSystem::add (Range &&tasks)
+{
+    std::vector< RC<AsyncTask> >    batch;
+
+    if constexpr( std::ranges::sized_range< Range >)
+        batch.reserve( std::ranges::size( tasks ));
+
+    for (auto& t : tasks) {
+        batch.push_back( RC<AsyncTask>{ t.to_async_task() });
+    }
+    add( std::span{ batch });
+}
+
+template <typename Fn>
+    requires( std::is_invocable_v< Fn >)
+inline auto  TaskSystem::add (Fn &&fn)
+{
+    auto    task = make_task( std::forward<Fn>(fn) );
+    add( task );
+    return task;
+}
+
+
+// Worker adds tasks to its own queue, other threads distribute tasks between all queues.
+inline size_t  TaskSystem::select_queue ()
+{
+    if ( _current == this )
+        return size_t(_workerIndex);
+
+    return _nextQueue.fetch_add( 1, std::memory_order_relaxed ) % _queueCount;
+}
+
+
+// Wake up to 'count' sleeping workers.
+inline void  TaskSystem::wake_workers (size_t count)
+{
+    _epoch.fetch_add( 1 );
+
+    const int   sleeping = _sleeping.load();
+    if ( sleeping == 0 )
+        return;
+
+    std::scoped_lock    lock {_sleepGuard};
+
+    if ( count >= size_t(sleeping) )
+        _sleepCV.notify_all();
+    else
+    {
+        for (size_t i = 0; i < count; ++i) {
+            _sleepCV.notify_one();
+        }
+    }
+}
+
+
+// Sleep until new task is added or completed.
+inline void  TaskSystem::sleep (unsigned epoch)
+{
+    std::unique_lock    lock {_sleepGuard};
+
+    _sleeping.fetch_add( 1 );
+
+    _sleepCV.wait( lock, [this, epoch] () { return _epoch.load() != epoch or not _looping.load(); });
+
+    _sleeping.fetch_sub( 1 );
+}
+
+
+inline bool  TaskSystem::is_current_thread (ThreadAffinity affinity) const
+{
+    // all tasks are executed by the owner thread
+    if ( _inline )
+        return std::this_thread::get_id() == _ownerThread;
+
+    switch ( affinity )
+    {
+        case ThreadAffinity::Any :     return _current == this;
+        case ThreadAffinity::Main :    return _mainThreadOf == this;
+    }
+    return _current == this and _workerIndex == int(affinity) % _queueCount;
+}
+
+
+// Extract the first task from the queue, all tasks in the queue are ready to be executed.
+inline RC<AsyncTask>  TaskSystem::extract_task (WorkerQueue &q, WorkerQueue::Queue_t &tasks)
+{
+    RC<AsyncTask>   task;
+    {
+        std::scoped_lock    lock {q.guard};
+
+        if ( tasks.empty() )
+            return {};
+
+        task = std::move( tasks.front() );
+        tasks.pop_front();
+    }
+
+    Status  stat = task->_status.exchange( Status::InProgress );
+    assert( stat == Status::InQueue );
+    (void)(stat);
+
+    return task;
+}
+
+
+// Extract task from own queue or steal task from another queue.
+inline RC<AsyncTask>  TaskSystem::extract_task (int worker, unsigned lane)
+{
+    const size_t    first = size_t(std::max( worker, 0 ));
+
+    const bool      balance = _costBalancing.load( std::memory_order_relaxed );
+
+    for (size_t i = 0; i < size_t(_queueCount); ++i)
+    {
+        const size_t    idx     = (first + i) % _queueCount;
+        auto&           q       = _queues[ idx ];
+        const bool      steal   = balance and int(idx) != worker;
+
+        if ( RC<AsyncTask> t = (steal ? extract_costly_task( q, q.lanes[lane] ) : extract_task( q, q.lanes[lane] )))
+        {
+            _laneSize[lane].fetch_sub( 1 );
+            return t;
+        }
+    }
+    return {};
+}
+
+
+// Extract the most expensive task from the first tasks of the queue, the first task is preferred when costs are equal.
+inline RC<AsyncTask>  TaskSystem::extract_costly_task (WorkerQueue &q, WorkerQueue::Queue_t &tasks)
+{
+    RC<AsyncTask>   task;
+    {
+        std::scoped_lock    lock {q.guard};
+
+        if ( tasks.empty() )
+            return {};
+
+        const size_t    count   = std::min( tasks.size(), MaxCostScan );
+        size_t          best    = 0;
+        int64_t         maxCost = estimated_cost( *tasks[0] );
+
+        for (size_t i = 1; i < count; ++i)
+        {
+            const int64_t   cost = estimated_cost( *tasks[i] );
+            if ( cost > maxCost )
+            {
+                maxCost = cost;
+                best    = i;
+            }
+        }
+
+        task = std::move( tasks[best] );
+        tasks.erase( tasks.begin() + ptrdiff_t(best) );
+    }
+
+    Status  stat = task->_status.exchange( Status::InProgress );
+    assert( stat == Status::InQueue );
+    (void)(stat);
+
+    return task;
+}
+
+
+// Extract the front task and following tasks of fine-grained types under a single lock.
+// Stolen batch takes at most a half of the victim lane.
+inline size_t  TaskSystem::extract_batch (WorkerQueue &q, unsigned lane, bool steal, RC<AsyncTask>* out, size_t maxCount)
+{
+    size_t  count = 0;
+    {
+        std::scoped_lock    lock {q.guard};
+        auto&               tasks = q.lanes[lane];
+
+        if ( tasks.empty() )
+            return 0;
+
+        if ( steal )
+            maxCount = std::min( maxCount, (tasks.size() + 1) / 2 );
+
+        out[count++] = std::move( tasks.front() );
+        tasks.pop_front();
+
+        if ( fine_grained_type( *out[0] ) != nullptr )
+        {
+            for (; count < maxCount and not tasks.empty() and fine_grained_type( *tasks.front() ) != nullptr; ++count)
+            {
+                out[count] = std::move( tasks.front() );
+                tasks.pop_front();
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        Status  stat = out[i]->_status.exchange( Status::InProgress );
+        assert( stat == Status::InQueue );
+        (void)(stat);
+    }
+
+    _laneSize[lane].fetch_sub( int(count) );
+    return count;
+}
+
+
+// Extract batch from own queue or steal batch from another queue and execute all tasks of the batch.
+// When cost balancing is enabled, thief steals a single task which is selected by cost, as in 'extract_task()'.
+inline bool  TaskSystem::process_batch (int worker, unsigned lane)
+{
+    RC<AsyncTask>   batch [MaxBatchSize];
+    size_t          count       = 0;
+    const size_t    maxCount    = std::clamp( _maxBatch.load( std::memory_order_relaxed ), 1u, MaxBatchSize );
+    const size_t    first       = size_t(std::max( worker, 0 ));
+    const bool      balance     = _costBalancing.load( std::memory_order_relaxed );
+
+    for (size_t i = 0; count == 0 and i < size_t(_queueCount); ++i)
+    {
+        const size_t    idx     = (first + i) % _queueCount;
+        auto&           q       = _queues[ idx ];
+        const bool      steal   = int(idx) != worker;
+
+        if ( steal and balance )
+        {
+            if (( batch[0] = extract_costly_task( q, q.lanes[lane] )))
+            {
+                _laneSize[lane].fetch_sub( 1 );
+                count = 1;
+            }
+        }
+        else
+            count = extract_batch( q, lane, steal, batch, maxCount );
+    }
+
+    if ( count == 0 )
+        return false;
+
+    if ( worker >= 0 )
+        _queues[worker].nextSince = {};
+
+    if ( count == 1 )
+    {
+        execute( std::move( batch[0] ));
+        return true;
+    }
+
+    // executed back-to-back without returning to the queue,
+    // per-task clock reads, stats and type measurements are accumulated locally
+    BatchState  state;
+    state.now = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < count; ++i) {
+        execute( std::move( batch[i] ), &state );
+    }
+
+    // all tasks of the batch have fine-grained types, otherwise the batch has a single task
+    for (size_t i = 0; i < state.typeCount; ++i)
+    {
+        const TypeSamples&  samples = state.types[i];
+        update_type( samples );
+        samples.type->batched.fetch_add( samples.count, std::memory_order_relaxed );
+    }
+
+    _statExecuted.fetch_add( state.executed, std::memory_order_relaxed );
+    _statCompleted.fetch_add( state.completed, std::memory_order_relaxed );
+    _statBatches.fetch_add( 1, std::memory_order_relaxed );
+    _statBatchedTasks.fetch_add( count, std::memory_order_relaxed );
+    return true;
+}
+
+
+inline TaskSystem::TypeEntry*  TaskSystem::find_type (const AsyncTask &task, bool insert)
+{
+    const void*     typeId  = task.type_id();
+    const size_t    hash = std::hash< const void* >{}( typeId ) ^ (size_t(typeId) >> 4);
+
+    for (size_t i = 0; i < TypeTableSize; ++i)
+    {
+        TypeEntry&      e   = _typeTable[ (hash + i) & (TypeTableSize - 1) ];
+        const void*     key = e.key.load( std::memory_order_acquire );
+
+        if ( key == typeId )
+            return &e;
+
+        if ( key == nullptr )
+        {
+            if ( not insert )
+                return nullptr;
+
+            if ( e.key.compare_exchange_strong( key, typeId ))
+            {
+                // name is slow, it is requested once per type
+                e.name = task.type_name();
+                e.hasName.store( true, std::memory_order_release );
+                return &e;
+            }
+            if ( key == typeId )
+                return &e;
+        }
+    }
+    return nullptr;  // table is full
+}
+
+
+inline TaskSystem::TypeEntry*  TaskSystem::fine_grained_type (const AsyncTask &task)
+{
+    TypeEntry*  type = find_type( task, false );
+    return type != nullptr and type->fineGrained.load( std::memory_order_relaxed ) ? type : nullptr;
+}
+
+
+// Duration is wall-clock time, so it includes time when the thread was preempted.
+// Such outliers are ignored by the moving average and do not move the median, which is used for classification.
+inline TaskSystem::TypeSamples  TaskSystem::begin_samples (TypeEntry &type, const void* typeId)
+{
+    // the first samples are always used in moving average
+    TypeSamples     samples;
+    samples.typeId      = typeId;
+    samples.type        = &type;
+    samples.maxInlier   = (type.count.load( std::memory_order_relaxed ) < MedianPeriod ? TaskTypeStats::BucketCount :
+                            type.median.load( std::memory_order_relaxed ) + OutlierBuckets);
+    return samples;
+}
+
+
+// Returns samples of the task type in the batch, 'null' if the type is not measured or the batch has too many types.
+inline TaskSystem::TypeSamples*  TaskSystem::batch_samples (BatchState &batch, const AsyncTask &task)
+{
+    const void*     typeId = task.type_id();
+
+    for (size_t i = 0; i < batch.typeCount; ++i)
+    {
+        if ( batch.types[i].typeId == typeId )
+            return &batch.types[i];
+    }
+
+    if ( batch.typeCount == BatchState::MaxTypes )
+        return nullptr;
+
+    TypeEntry*  type = find_type( task, true );
+    if ( type == nullptr )
+        return nullptr;
+
+    auto&   samples = batch.types[ batch.typeCount++ ];
+    samples = begin_samples( *type, typeId );
+    return &samples;
+}
+
+
+inline void  TaskSystem::add_sample (TypeSamples &samples, int64_t durationNs)
+{
+    const unsigned  bucket = TaskTypeStats::Bucket( durationNs );
+
+    ++samples.count;
+    samples.totalNs += durationNs;
+    ++samples.histogram[ bucket ];
+
+    // outliers are counted in the window, so the median follows when the type becomes slower
+    if ( bucket <= samples.maxInlier )
+    {
+        ++samples.inliers;
+        samples.inlierNs += durationNs;
+    }
+}
+
+
+inline void  TaskSystem::update_type (const TypeSamples &samples)
+{
+    TypeEntry&      type    = *samples.type;
+    const size_t    count   = type.count.fetch_add( samples.count, std::memory_order_relaxed ) + samples.count;
+
+    type.totalNs.fetch_add( size_t(samples.totalNs), std::memory_order_relaxed );
+
+    for (unsigned b = 0; b < TaskTypeStats::BucketCount; ++b)
+    {
+        if ( samples.histogram[b] > 0 )
+        {
+            type.histogram[b].fetch_add( samples.histogram[b], std::memory_order_relaxed );
+            type.window[b].fetch_add( samples.histogram[b], std::memory_order_relaxed );
+        }
+    }
+
+    // approximate moving average, concurrent updates may be lost,
+    // samples of the batch are replaced by their mean
+    if ( samples.inliers > 0 )
+    {
+        const uint32_t  cur     = uint32_t(std::min<int64_t>( samples.inlierNs / int64_t(samples.inliers), UINT32_MAX ));
+        uint32_t        recent  = type.recentNs.load( std::memory_order_relaxed );
+
+        for (size_t i = 0; i < samples.inliers; ++i) {
+            recent = (recent == 0 ? cur : uint32_t((uint64_t(recent) * 7 + cur) / 8));
+        }
+        type.recentNs.store( recent, std::memory_order_relaxed );
+    }
+
+    // median and classification are updated when the counter crosses the period
+    if ( count / MedianPeriod == (count - samples.count) / MedianPeriod )
+        return;
+
+    uint32_t    window [TaskTypeStats::BucketCount];
+    size_t      total   = 0;
+
+    for (unsigned b = 0; b < TaskTypeStats::BucketCount; ++b) {
+        total += (window[b] = type.window[b].load( std::memory_order_relaxed ));
+    }
+
+    unsigned    median  = 0;
+    for (size_t sum = window[0]; sum * 2 < total; sum += window[++median]) {}
+
+    type.median.store( median, std::memory_order_relaxed );
+
+    // forget old samples
+    if ( total >= TypeWindow )
+    {
+        for (unsigned b = 0; b < TaskTypeStats::BucketCount; ++b) {
+            type.window[b].fetch_sub( window[b] / 2, std::memory_order_relaxed );
+        }
+    }
+
+    // hysteresis, so type does not switch on every measurement
+    const int64_t   threshold = _coarseThresholdNs.load( std::memory_order_relaxed );
+    if ( count >= MinTypeSamples )
+    {
+        if ( TaskTypeStats::UpperBound( median ) <= threshold )
+            type.fineGrained.store( true, std::memory_order_relaxed );
+        else
+        if ( TaskTypeStats::LowerBound( median ) >= threshold * 2 )
+            type.fineGrained.store( false, std::memory_order_relaxed );
+    }
+}
+
+
+// Returns cost hint of the task or recent duration of its type, 0 if unknown.
+inline int64_t  TaskSystem::estimated_cost (const AsyncTask &task)
+{
+    if ( task._costHint > 0 )
+        return task._costHint;
+
+    const TypeEntry*    type = find_type( task, false );
+    return type != nullptr ? int64_t(type->recentNs.load( std::memory_order_relaxed )) : 0;
+}
+
+
+// Longest processing time first: tasks are sorted by cost and each task goes to the part with the smallest total cost.
+// Returns task indices grouped by parts, part 'p' is in range [bounds[p], bounds[p+1]), the most expensive task is the first.
+inline void  TaskSystem::balance_by_cost (std::span< RC<AsyncTask> > tasks, size_t parts, std::vector<uint32_t> &order, std::vector<size_t> &bounds)
+{
+    std::vector< int64_t >  cost        (tasks.size());
+    int64_t                 knownSum    = 0;
+    size_t                  knownCount  = 0;
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        cost[i] = estimated_cost( *tasks[i] );
+        if ( cost[i] > 0 )
+        {
+            knownSum += cost[i];
+            ++knownCount;
+        }
+    }
+
+    // unknown tasks are expected to be average
+    const int64_t   average = knownCount > 0 ? std::max( knownSum / int64_t(knownCount), int64_t{1} ) : 1;
+    for (auto& c : cost) {
+        c = (c > 0 ? c : average);
+    }
+
+    std::vector<uint32_t>   byCost (tasks.size());
+    std::iota( byCost.begin(), byCost.end(), 0u );
+    std::stable_sort( byCost.begin(), byCost.end(), [&cost] (uint32_t lhs, uint32_t rhs) { return cost[lhs] > cost[rhs]; });
+
+    std::vector< int64_t >  load    (parts);
+    std::vector< uint32_t > partOf  (tasks.size());
+    bounds.assign( parts + 1, 0 );
+
+    for (uint32_t i : byCost)
+    {
+        const size_t    p = size_t(std::min_element( load.begin(), load.end() ) - load.begin());
+        partOf[i]   = uint32_t(p);
+        load[p]    += cost[i];
+        ++bounds[p+1];
+    }
+    for (size_t p = 0; p < parts; ++p) {
+        bounds[p+1] += bounds[p];
+    }
+
+    std::vector<size_t>     pos {bounds.begin(), bounds.end() - 1};
+    order.resize( tasks.size() );
+
+    for (uint32_t i : byCost) {
+        order[ pos[ partOf[i] ]++ ] = i;
+    }
+}
+
+
+inline void  TaskSystem::set_coarsening (bool enabled, std::chrono::nanoseconds threshold, unsigned maxBatch)
+{
+    _coarseThresholdNs.store( threshold.count() );
+    _maxBatch.store( std::clamp( maxBatch, 1u, MaxBatchSize ));
+    _coarsening.store( enabled );
+}
+
+
+inline std::vector< TaskSystem::TaskTypeStats >  TaskSystem::type_stats () const
+{
+    std::vector< TaskTypeStats >    result;
+
+    for (size_t i = 0; i < TypeTableSize; ++i)
+    {
+        const TypeEntry&    e = _typeTable[i];
+        if ( e.key.load() == nullptr )
+            continue;
+
+        auto&   s = result.emplace_back();
+        s.typeId        = e.key.load();
+        if ( e.hasName.load( std::memory_order_acquire ))
+            s.typeName  = e.name;
+        s.count         = e.count.load();
+        s.batched       = e.batched.load();
+        s.meanNs        = s.count > 0 ? double(e.totalNs.load()) / double(s.count) : 0.0;
+        s.recentNs      = e.recentNs.load();
+        s.median        = e.median.load();
+        s.fineGrained   = e.fineGrained.load();
+
+        for (unsigned b = 0; b < TaskTypeStats::BucketCount; ++b) {
+            s.histogram[b] = e.histogram[b].load();
+        }
+    }
+
+    std::sort( result.begin(), result.end(), [] (auto& lhs, auto& rhs) { return lhs.count > rhs.count; });
+    return result;
+}
+
+
+inline std::string  TaskSystem::type_stats_text (size_t maxEntries) const
+{
+    // upper bound of the bucket
+    const auto  Label = [] (unsigned bucket) -> std::string
+    {
+        const bool      last    = (bucket + 1 == TaskTypeStats::BucketCount);
+        const uint64_t  ns      = uint64_t(1) << (bucket + (last ? 7 : 8));
+        std::string     result  = (last ? ">" : "<");
+
+        if ( ns < 1'000 )           { result += std::to_string( ns );               result += "ns"; }
+        else if ( ns < 1'000'000 )  { result += std::to_string( ns / 1'000 );       result += "us"; }
+        else                        { result += std::to_string( ns / 1'000'000 );   result += "ms"; }
+        return result;
+    };
+
+    // name of the type, id if the name is not recorded, long names are cut from the beginning
+    constexpr size_t    NameWidth   = 40;
+    const auto          Name        = [] (const TaskTypeStats &t) -> std::string
+    {
+        if ( t.typeName.empty() )
+        {
+            std::stringstream   id;
+            id << t.typeId;
+            return id.str();
+        }
+        if ( t.typeName.size() < NameWidth )
+            return t.typeName;
+
+        return "..." + t.typeName.substr( t.typeName.size() - (NameWidth - 4) );
+    };
+
+    const auto          types = type_stats();
+    std::stringstream   str;
+
+    str << std::left << std::setw(NameWidth) << "type" << std::right << std::setw(10) << "count" << std::setw(10) << "mean ns" << std::setw(10) << "median" << std::setw(10) << "batched" << "  fine  histogram\n";
+
+    for (size_t i = 0; i < std::min( maxEntries, types.size() ); ++i)
+    {
+        const auto&     t = types[i];
+        str << std::left << std::setw(NameWidth) << Name( t ) << std::right << std::setw(10) << t.count << std::setw(10) << size_t(t.meanNs)
+            << std::setw(10) << Label( t.median ) << std::setw(10) << t.batched << (t.fineGrained ? "  yes " : "  no  ");
+
+        for (unsigned b = 0; b < TaskTypeStats::BucketCount; ++b)
+        {
+            if ( t.histogram[b] > 0 )
+                str << " " << Label( b ) << ":" << t.histogram[b];
+        }
+        str << "\n";
+    }
+    return str.str();
+}
+
+
+inline void  TaskSystem::reset_type_stats ()
+{
+    for (size_t i = 0; i < TypeTableSize; ++i)
+    {
+        TypeEntry&  e = _typeTable[i];
+        e.count.store( 0 );
+        e.batched.store( 0 );
+        e.totalNs.store( 0 );
+        e.recentNs.store( 0 );
+        e.median.store( 0 );
+        e.fineGrained.store( false );
+
+        for (auto& h : e.histogram) {
+            h.store( 0 );
+        }
+        for (auto& w : e.window) {
+            w.store( 0 );
+        }
+    }
+}
+
+
+// Comparator for heap, returns 'true' if 'lhs' must be executed after 'rhs'.
+inline bool  TaskSystem::earlier_deadline (const RC<AsyncTask> &lhs, const RC<AsyncTask> &rhs)
+{
+    return lhs->_deadline > rhs->_deadline;
+}
+
+
+// Extract task with the earliest deadline.
+inline RC<AsyncTask>  TaskSystem::extract_deadline_task (WorkerQueue &q)
+{
+    RC<AsyncTask>   task;
+    {
+        std::scoped_lock    lock {q.guard};
+        auto&               heap = q.deadlines;
+
+        if ( heap.empty() )
+            return {};
+
+        std::pop_heap( heap.begin(), heap.end(), &earlier_deadline );
+        task = std::move( heap.back() );
+        heap.pop_back();
+    }
+
+    Status  stat = task->_status.exchange( Status::InProgress );
+    assert( stat == Status::InQueue );
+    (void)(stat);
+
+    _deadlineSize.fetch_sub( 1 );
+    return task;
+}
+
+
+// Extract task from own heap or steal task with the closest deadline from another queue.
+inline RC<AsyncTask>  TaskSystem::extract_deadline_task (int worker)
+{
+    if ( _deadlineSize.load() <= 0 )
+        return {};
+
+    if ( worker >= 0 )
+    {
+        if ( RC<AsyncTask> t = extract_deadline_task( _queues[worker] ))
+            return t;
+    }
+
+    // sort queues by the closest deadline
+    std::array< std::pair< AsyncTask::TimePoint_t, int >, 32 >  order;
+    int                                                         count = 0;
+
+    for (int i = 0; i < _queueCount; ++i)
+    {
+        if ( i == worker )
+            continue;
+
+        std::scoped_lock    lock {_queues[i].guard};
+        if ( not _queues[i].deadlines.empty() )
+            order[count++] = { _queues[i].deadlines[0]->_deadline, i };
+    }
+    std::sort( order.begin(), order.begin() + count );
+
+    for (int i = 0; i < count; ++i)
+    {
+        if ( RC<AsyncTask> t = extract_deadline_task( _queues[ order[i].second ]))
+            return t;
+    }
+    return {};
+}
+
+
+// Extract task from the LIFO slot.
+// Other workers can 'steal' the task only if the owner has started another task since the slot was set,
+// otherwise the owner is finishing the task which readied the continuation and executes it next.
+inline RC<AsyncTask>  TaskSystem::extract_next_task (WorkerQueue &q, bool steal)
+{
+    RC<AsyncTask>   task;
+    {
+        std::scoped_lock    lock {q.guard};
+
+        if ( not q.next )
+            return {};
+
+        if ( steal and q.nextStamp == q.started.load( std::memory_order_relaxed ))
+            return {};
+
+        task = std::move( q.next );
+    }
+
+    Status  stat = task->_status.exchange( Status::InProgress );
+    assert( stat == Status::InQueue );
+    (void)(stat);
+
+    return task;
+}
+
+// Steal task from the LIFO slot of any worker, starting from 'worker'.
+inline RC<AsyncTask>  TaskSystem::steal_next_task (int worker)
+{
+    const size_t    first = size_t(std::max( worker, 0 ));
+
+    for (size_t i = 0; i < size_t(_queueCount); ++i)
+    {
+        if ( RC<AsyncTask> t = extract_next_task( _queues[ (first + i) % _queueCount ], (i != 0 or worker < 0) ))
+            return t;
+    }
+    return {};
+}
+
+
+// Returns 'true' if time slice of the current task is over or higher priority task is waiting.
+inline bool  TaskSystem::should_yield ()
+{
+    AsyncTask*  task = _runningTask;
+    if ( task == nullptr or task->_system == nullptr )
+        return false;
+
+    TaskSystem&     ts = *task->_system;
+
+    if ( std::chrono::steady_clock::now() - _sliceStart >= ts.time_slice() )
+        return true;
+
+    // tasks with deadline are executed before tasks without deadline
+    if ( task->_deadline == AsyncTask::TimePoint_t::max() and ts._deadlineSize.load( std::memory_order_relaxed ) > 0 )
+        return true;
+
+    for (unsigned lane = 0; lane < unsigned(task->_priority); ++lane)
+    {
+        if ( ts._laneSize[lane].load( std::memory_order_relaxed ) > 0 )
+            return true;
+    }
+    return false;
+}
+
+
+inline void  TaskSystem::execute (RC<AsyncTask> t, BatchState* batch)
+{
+    AsyncTask*  prevTask    = std::exchange( _runningTask, t.get() );
+    auto        prevStart   = std::exchange( _sliceStart, batch != nullptr ? batch->now : std::chrono::steady_clock::now() );
+
+    // Hold extra counter, so dependency which is completed during 'run()' can not requeue the task
+    // while it is still executing.
+    t->_waitCount.fetch_add( 1 );
+
+    // task is counted by the system which added it to the queue, it can differ from the system which executes the strand
+    if ( TaskSystem* queuedOf = std::exchange( t->_queuedOf, nullptr ))
+        queuedOf->release_slots( t->_priority, 1, 0 );
+
+    TypeSamples*    samples = (batch != nullptr ? batch_samples( *batch, *t ) : nullptr);
+    TypeEntry*      type    = (samples == nullptr and (_coarsening.load( std::memory_order_relaxed ) or _costBalancing.load( std::memory_order_relaxed )) ?
+                                find_type( *t, true ) : nullptr);
+
+    // previous task is restored, because 'run_until()' executes nested tasks
+    WorkerQueue*    sampled     = nullptr;
+    AsyncTask*      prevSampled = nullptr;
+
+    if ( _samplers.load( std::memory_order_relaxed ) > 0 and _current == this )
+    {
+        sampled = &_queues[ _workerIndex ];
+        std::scoped_lock    lock {sampled->runningGuard};
+        prevSampled = std::exchange( sampled->running, t.get() );
+    }
+
+    // Execute task/coroutine.
+    if ( TaskRecorder* rec = recorder() )
+    {
+        const auto  begin = _sliceStart;
+        t->run();
+        rec->on_run( *t, begin, std::chrono::steady_clock::now() );
+    }
+    else
+        t->run();
+
+    if ( batch != nullptr )
+    {
+        const auto  end = std::chrono::steady_clock::now();
+        batch->now = end;
+
+        if ( samples != nullptr )
+            add_sample( *samples, std::chrono::duration_cast< std::chrono::nanoseconds >( end - _sliceStart ).count() );
+    }
+
+    if ( type != nullptr )
+    {
+        TypeSamples     single = begin_samples( *type, nullptr );
+        add_sample( single, std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - _sliceStart ).count() );
+        update_type( single );
+    }
+
+    if ( sampled != nullptr )
+    {
+        std::scoped_lock    lock {sampled->runningGuard};
+        sampled->running = prevSampled;
+    }
+
+    if ( batch != nullptr )
+        ++batch->executed;
+    else
+        _statExecuted.fetch_add( 1, std::memory_order_relaxed );
+
+    _runningTask    = prevTask;
+    _sliceStart     = prevStart;
+
+    // If not complete - add back to the queue if there are no pending dependencies,
+    // otherwise the last completed dependency will requeue the task.
+    // Task may be moved to another thread by 'switch_to()', to another task system by 'schedule_on()'
+    // or added to the back of the lane by 'yield_now()'.
+    if ( not t->is_complete() )
+    {
+        if ( t->_waitCount.fetch_sub( 1 ) == 1 )
+        {
+            TaskSystem*     dst = t->_system;
+            dst->requeue( std::move(t) );
+        }
+    }
+    else
+    {
+        if ( batch != nullptr )
+            ++batch->completed;
+        else
+            _statCompleted.fetch_add( 1, std::memory_order_relaxed );
+
+        if ( TaskSystem* inFlightOf = std::exchange( t->_inFlightOf, nullptr ))
+            inFlightOf->release_slots( t->_priority, 0, 1 );
+
+        if ( t->_deadline != AsyncTask::TimePoint_t::max() )
+        {
+            const auto  now = std::chrono::steady_clock::now();
+            if ( now > t->_deadline )
+            {
+                _statDeadlineMissed.fetch_add( 1, std::memory_order_relaxed );
+
+                // application can shed load
+                if ( _onDeadlineMiss )
+                    _onDeadlineMiss( *t, now - t->_deadline );
+            }
+        }
+    }
+}
+
+
+// Execute single task from own queue, if there are no ready tasks then steal task from another queue.
+// If 'worker' is negative then tasks with any affinity can be executed.
+// Returns 'false' if no tasks are executed.
+inline bool  TaskSystem::process_tasks (int worker)
+{
+    RC<AsyncTask>   t;
+
+    if ( worker >= 0 )
+    {
+        // from now the task in the LIFO slot can be stolen if the owner selects another task
+        _queues[worker].started.fetch_add( 1, std::memory_order_relaxed );
+
+        t = extract_task( _queues[worker], _queues[worker].pinned );
+    }
+
+    if ( not t )
+        t = extract_deadline_task( worker );
+
+    // Continuation which is readied by this worker, so a chain of continuations runs while its data is in cache.
+    // Consecutive runs are limited by the time slice to keep tasks in the lanes from starvation.
+    bool    fromSlot = false;
+    if ( not t and worker >= 0 )
+    {
+        auto&   q = _queues[worker];
+        if ( q.nextSince == std::chrono::steady_clock::time_point{} or
+             std::chrono::steady_clock::now() - q.nextSince < time_slice() )
+        {
+            t           = extract_next_task( q, false );
+            fromSlot    = bool(t);
+        }
+    }
+
+    // higher priority tasks are stolen before own lower priority tasks
+    const bool  coarsening = _coarsening.load( std::memory_order_relaxed );
+    for (unsigned lane = 0; not t and lane < LaneCount; ++lane)
+    {
+        if ( coarsening )
+        {
+            if ( process_batch( worker, lane ))
+                return true;
+        }
+        else
+            t = extract_task( worker, lane );
+    }
+
+    // all lanes are empty, steal from LIFO slots
+    if ( not t )
+        t = steal_next_task( worker );
+
+    if ( worker >= 0 )
+    {
+        auto&   since = _queues[worker].nextSince;
+
+        if ( fromSlot )
+        {
+            if ( since == std::chrono::steady_clock::time_point{} )
+                since = std::chrono::steady_clock::now();
+
+            _statNextSlot.fetch_add( 1, std::memory_order_relaxed );
+        }
+        else
+            since = {};
+    }
+
+    if ( worker < 0 )
+    {
+        for (int i = 0; not t and i < _queueCount; ++i)
+        {
+            t = extract_task( _queues[i], _queues[i].pinned );
+        }
+        for (unsigned lane = 0; not t and lane < LaneCount; ++lane)
+        {
+            t = extract_task( _mainQueue, _mainQueue.lanes[lane] );
+        }
+    }
+
+    if ( t )
+    {
+        execute( std::move(t) );
+        return true;
+    }
+    return false;
+}
+
+
+// Execute single task with any affinity or with main thread affinity, used by thread which is not a worker.
+inline bool  TaskSystem::process_any_task (bool mainThread)
+{
+    RC<AsyncTask>   t = extract_deadline_task( -1 );
+
+    for (unsigned lane = 0; not t and lane < LaneCount; ++lane)
+    {
+        t = extract_task( -1, lane );
+
+        if ( not t and mainThread )
+            t = extract_task( _mainQueue, _mainQueue.lanes[lane] );
+    }
+
+    if ( not t )
+        t = steal_next_task( -1 );
+
+    if ( t )
+    {
+        execute( std::move(t) );
+        return true;
+    }
+    return false;
+}
+
+
+// Execute task which can be executed only by the current thread.
+inline bool  TaskSystem::process_pinned_task (int worker, bool mainThread)
+{
+    RC<AsyncTask>   t;
+
+    if ( worker >= 0 )
+        t = extract_task( _queues[worker], _queues[worker].pinned );
+
+    for (unsigned lane = 0; not t and mainThread and lane < LaneCount; ++lane) {
+        t = extract_task( _mainQueue, _mainQueue.lanes[lane] );
+    }
+
+    if ( t )
+    {
+        execute( std::move(t) );
+        return true;
+    }
+    return false;
+}
+
+
+template <typename T>
+inline T  TaskSystem::run_until (Task<T> task)
+{
+    run_until( RC<AsyncTask>{ task.to_async_task() });
+    return task.get_result();
+}
+
+inline void  TaskSystem::run_until (RC<AsyncTask> task)
+{
+    assert( task );
+    assert( task.get() != _runningTask );  // deadlock
+
+    add( task );
+
+    if ( _inline )
+    {
+        assert( std::this_thread::get_id() == _ownerThread );
+
+        for (; not task->is_complete();)
+        {
+            // target depends on another task system
+            if ( not process_inline() )
+                std::this_thread::yield();
+        }
+        return;
+    }
+
+    const int       worker      = (_current == this ? _workerIndex : -1);
+    const bool      mainThread  = (_mainThreadOf == this);
+
+    if ( _runUntilDepth >= MaxRunUntilDepth )
+    {
+        for (; not task->is_complete();)
+        {
+            if ( not process_pinned_task( worker, mainThread ))
+                std::this_thread::yield();
+        }
+        return;
+    }
+
+    ++_runUntilDepth;
+
+    for (; not task->is_complete();)
+    {
+        const bool  executed = (worker >= 0 ? process_tasks( worker ) : process_any_task( mainThread ));
+
+        // target is executed by another thread
+        if ( not executed )
+            std::this_thread::yield();
+    }
+
+    --_runUntilDepth;
+}
+
+
+inline size_t  TaskSystem::process_main_thread (std::chrono::nanoseconds timeBudget)
+{
+    const auto      end     = std::chrono::steady_clock::now() + timeBudget;
+    size_t          count   = 0;
+    TaskSystem*     prev    = std::exchange( _mainThreadOf, this );
+
+    for (; std::chrono::steady_clock::now() < end; ++count)
+    {
+        if ( _inline )
+        {
+            if ( not process_inline() )
+                break;
+            continue;
+        }
+
+        RC<AsyncTask>   t;
+        for (unsigned lane = 0; not t and lane < LaneCount; ++lane)
+        {
+            t = extract_task( _mainQueue, _mainQueue.lanes[lane] );
+        }
+        if ( not t )
+            break;
+
+        execute( std::move(t) );
+    }
+
+    _mainThreadOf = prev;
+    return count;
+}
+
+
+[[nodiscard]] inline bool  TaskSystem::has_tasks ()
+{
+    // other threads can see only tasks which are readied remotely
+    if ( _inline )
+    {
+        const bool  owner = (std::this_thread::get_id() == _ownerThread);
+        return (owner and not _inlineReady.empty()) or _remoteCount.load() > 0;
+    }
+
+    const auto  NotEmpty = [] (WorkerQueue &q)
+    {
+        std::scoped_lock    lock {q.guard};
+        return  not q.pinned.empty() or not q.deadlines.empty() or q.next or
+                std::any_of( std::begin(q.lanes), std::end(q.lanes), [] (auto& lane) { return not lane.empty(); });
+    };
+
+    for (int i = 0; i < _queueCount; ++i)
+    {
+        if ( NotEmpty( _queues[i] ))
+            return true;
+    }
+    return NotEmpty( _mainQueue );
+}
+
+
+inline void  TaskSystem::init_threads (int count)
+{
+    _looping.store( true );
+
+    if ( count == 0 )
+    {
+        _inline         = true;
+        _ownerThread    = std::this_thread::get_id();
+        return;
+    }
+
+    _queueCount = std::clamp( count, 1, 32 );
+    _queues     = std::make_unique< WorkerQueue[] >( _queueCount );
+
+    for (int i = 0; i < _queueCount; ++i)
+    {
+        _threads.push_back( std::thread{ [this, i] ()
+                            {
+                                _workerIndex    = i;
+                                _current        = this;
+
+                                for (; _looping.load();)
+                                {
+                                    const unsigned  epoch = _epoch.load();
+
+                                    if ( not process_tasks( i ))
+                                        sleep( epoch );
+                                }
+                            }});
+    }
+}
+
+
+inline void  TaskSystem::wait ()
+{
+    std::this_thread::sleep_for( std::chrono::seconds{3} );
+    stop();
+}
+
+
+// Stop worker threads and complete all remaining tasks in the current thread.
+inline void  TaskSystem::stop ()
+{
+    _looping.store( false );
+    {
+        std::scoped_lock    lock {_sleepGuard};
+        _sleepCV.notify_all();
+    }
+
+    for (auto& t : _threads) {
+        t.join();
+    }
+    _threads.clear();
+
+    if ( _inline )
+    {
+        for (; process_inline();) {}
+        return;
+    }
+
+    for (; has_tasks();)
+    {
+        process_tasks( -1 );
+    }
+}
+
+
+template <typename T>
+inline void  Strand::add (Task<T> task)
+{
+    return add( RC<AsyncTask>{ task.to_async_task() });
+}
+
+inline void  Strand::add (RC<AsyncTask> task)
+{
+    assert( task );
+
+    task->_strand = this;
+    _ts.add( std::move(task) );
+}
+
+template <typename Fn>
+    requires( std::is_invocable_v< Fn >)
+inline auto  Strand::add (Fn &&fn)
+{
+    auto    task = make_task( std::forward<Fn>(fn) );
+    add( task );
+    return task;
+}
+
+
+// Add task which is ready to be executed to the strand queue.
+inline void  Strand::push (RC<AsyncTask> task)
+{
+    assert( task->_status.load() == AsyncTask::Status::InQueue );
+
+    AsyncTask*  t       = task.detach();
+    AsyncTask*  head    = _head.load( std::memory_order_relaxed );
+
+    do {
+        t->_strandNext = head;
+    }
+    while ( not _head.compare_exchange_weak( head, t, std::memory_order_release, std::memory_order_relaxed ));
+
+    // strand was idle
+    if ( _pending.fetch_add( 1 ) == 0 )
+        _ts.add( [this] () { drain(); });
+}
+
+
+// Execute all tasks which are in the queue at the moment, then continue in a new task if more tasks are added.
+inline void  Strand::drain ()
+{
+    AsyncTask*  batch = _head.exchange( nullptr, std::memory_order_acquire );
+
+    // restore FIFO order
+    AsyncTask*  list = nullptr;
+    for (; batch != nullptr;)
+    {
+        AsyncTask*  next = std::exchange( batch->_strandNext, list );
+        list  = batch;
+        batch = next;
+    }
+
+    int     count = 0;
+    for (; list != nullptr; ++count)
+    {
+        RC<AsyncTask>   t {list};
+        list = std::exchange( t->_strandNext, nullptr );
+        t->_refCount.fetch_sub( 1 );    // reference was detached in 'push()'
+
+        AsyncTask::Status   stat = t->_status.exchange( AsyncTask::Status::InProgress );
+        assert( stat == AsyncTask::Status::InQueue );
+        (void)(stat);
+
+        // if coroutine is suspended it will be added back to the strand
+        _ts.execute( std::move(t) );
+    }
+
+    // add drain to the back of the queue to let other tasks run
+    if ( _pending.fetch_sub( count ) != count )
+        _ts.add( [this] () { drain(); });
+}
+
+
+template <typename T, typename ...Deps>
+inline void  TickClock::add (TaskSystem &ts, Task<T> task, const Task<Deps>& ...deps)
+{
+    {
+        std::scoped_lock    lock {_guard};
+        assert( is_finished() );
+        assert( not _stopped );
+
+        const auto  idx = uint32_t(_entries.size());
+        auto&       e   = _entries.emplace_back();
+
+        e.task          = task.to_async_task();
+        e.depCount      = uint32_t(sizeof...(Deps));
+        e.startedTick   = _tick;    // new task joins from the next tick
+        e.finishedTick  = _tick;
+
+        const std::array< AsyncTask*, sizeof...(Deps) >     depList {{ deps.to_async_task() ... }};
+
+        for (AsyncTask* dep : depList)
+        {
+            const size_t    d = find( dep );
+            assert( d < idx );
+            _entries[d].dependents.push_back( idx );
         }
-        if ( t )
+        ++_finished;
+    }
+
+    // task is executed until the first 'next_tick()'
+    ts.add( std::move(task) );
+}
+
+
+inline bool  TickClock::tick ()
+{
+    std::scoped_lock    lock {_guard};
+    assert( not _stopped );
+
+    if ( not is_finished() )
+        return false;
+
+    ++_tick;
+    _finished = 0;
+
+    for (auto& e : _entries) {
+        e.remaining = e.depCount;
+    }
+    for (auto& e : _entries)
+    {
+        if ( e.remaining == 0 )
+            try_start( e );
+    }
+    return true;
+}
+
+
+inline void  TickClock::stop ()
+{
+    std::scoped_lock    lock {_guard};
+    _stopped.store( true );
+
+    for (auto& e : _entries)
+    {
+        if ( RC<AsyncTask> t = std::move( e.suspended ))
         {
-            // Execute task/coroutine.
-            t->run();
+            if ( t->_waitCount.fetch_sub( 1 ) == 1 )
+                t->_system->requeue( std::move(t) );
+        }
+    }
+}
 
-            // If not complete - add back to the queue and wait until new dependencies are complete.
-            if ( not t->is_complete() )
-            {
-                assert( t->has_dependencies() );
 
-                add( t );
-            }
+inline bool  TickClock::is_tick_finished ()
+{
+    std::scoped_lock    lock {_guard};
+    return is_finished();
+}
+
+inline uint64_t  TickClock::tick_index ()
+{
+    std::scoped_lock    lock {_guard};
+    return _tick;
+}
+
+
+inline size_t  TickClock::find (const AsyncTask* task) const
+{
+    for (size_t i = 0; i < _entries.size(); ++i)
+    {
+        if ( _entries[i].task == task )
+            return i;
+    }
+    assert( false );    // task is not registered
+    return _entries.size();
+}
+
+
+// Resume task if it is already waiting, otherwise it will start the tick in 'on_tick_end()'.
+inline void  TickClock::try_start (Entry &e)
+{
+    if ( not e.suspended )
+        return;
+
+    e.startedTick = _tick;
+
+    RC<AsyncTask>   t = std::move( e.suspended );
+    if ( t->_waitCount.fetch_sub( 1 ) == 1 )
+        t->_system->requeue( std::move(t) );
+}
+
+
+// Called when coroutine has finished the current tick, returns 'false' to continue the next tick without suspension.
+inline bool  TickClock::on_tick_end (AsyncTask &task)
+{
+    std::scoped_lock    lock {_guard};
+
+    if ( _stopped )
+        return false;
+
+    Entry&  e = _entries[ find( &task )];
+
+    if ( e.startedTick == _tick and e.finishedTick < _tick )
+    {
+        e.finishedTick = _tick;
+        ++_finished;
+        for (uint32_t d : e.dependents)
+        {
+            auto&   dep = _entries[d];
+            if ( --dep.remaining == 0 )
+                try_start( dep );
         }
     }
+
+    // task arrived after the tick has been started and all its dependencies are finished
+    if ( e.startedTick < _tick and e.remaining == 0 )
+    {
+        e.startedTick = _tick;
+        return false;
+    }
+
+    // wait for the next tick
+    task._waitCount.fetch_add( 1 );
+    e.suspended = RC<AsyncTask>{ &task };
+    return true;
 }
 
 
-inline void  TaskSystem::init_threads (int count)
+inline void  TaskSystem::set_task_limit (size_t value)
 {
-    _looping.store( true );
+    {
+        std::scoped_lock    lock {_slotGuard};
+        _taskLimit = value;
+    }
+    // limit can be increased
+    pass_slots();
+}
 
-    for (int i = 0, cnt = std::clamp(count, 1, 32); i < cnt; ++i)
+inline void  TaskSystem::set_task_limit (TaskPriority lane, size_t value)
+{
+    assert( lane < TaskPriority::_Count );
     {
-        _threads.push_back( std::thread{ [this, i] ()
-                            {
-                                for (; _looping.load();)
-                                {
-                                    process_tasks(i);
-                                }
-                            }});
+        std::scoped_lock    lock {_slotGuard};
+        _laneLimit[ unsigned(lane) ] = value;
     }
+    pass_slots();
 }
 
+inline void  TaskSystem::set_queue_limit (size_t value)
+{
+    {
+        std::scoped_lock    lock {_slotGuard};
+        _queueLimit = value;
+    }
+    pass_slots();
+}
 
-inline void  TaskSystem::wait ()
+inline void  TaskSystem::set_queue_limit (TaskPriority lane, size_t value)
 {
-    std::this_thread::sleep_for( std::chrono::seconds{3} );
+    assert( lane < TaskPriority::_Count );
+    {
+        std::scoped_lock    lock {_slotGuard};
+        _laneQueueLimit[ unsigned(lane) ] = value;
+    }
+    pass_slots();
+}
 
-    _looping.store( false );
 
-    for (auto& t : _threads) {
-        t.join();
+// Count task which is added to the queue, new task is counted as in flight until it is complete.
+// Task which is added with reservation is already counted by 'acquire_slots()'.
+inline void  TaskSystem::count_enqueued (AsyncTask &task)
+{
+    const unsigned  lane = unsigned(task._priority);
+
+    if ( task._inFlightOf == nullptr )
+    {
+        task._inFlightOf = this;
+        _laneInFlight[lane].fetch_add( 1 );
     }
-    _threads.clear();
+    if ( task._queuedOf == nullptr )
+    {
+        task._queuedOf = this;
+        _laneQueued[lane].fetch_add( 1 );
+    }
+}
+
+
+// Must be called under '_slotGuard'.
+inline bool  TaskSystem::has_slots (TaskPriority lane, size_t count) const
+{
+    size_t  queued      = 0;
+    size_t  inFlight    = 0;
+
+    for (unsigned i = 0; i < LaneCount; ++i)
+    {
+        queued   += _laneQueued[i].load();
+        inFlight += _laneInFlight[i].load();
+    }
+
+    const unsigned  i = unsigned(lane);
+    return  inFlight + count <= _taskLimit                  and
+            _laneInFlight[i].load() + count <= _laneLimit[i] and
+            queued + count <= _queueLimit                   and
+            _laneQueued[i].load() + count <= _laneQueueLimit[i];
+}
 
-    for (; not _queue.empty();)
+// Must be called under '_slotGuard'.
+// Reserved tasks are counted as queued and in flight, because they will be added to the queue.
+inline void  TaskSystem::acquire_slots (TaskPriority lane, size_t count)
+{
+    _laneQueued[ unsigned(lane) ].fetch_add( count );
+    _laneInFlight[ unsigned(lane) ].fetch_add( count );
+}
+
+
+// Producers which are waiting for slots have priority.
+inline bool  TaskSystem::try_acquire_slots (TaskPriority lane, size_t count)
+{
+    assert( lane < TaskPriority::_Count );
+    std::scoped_lock    lock {_slotGuard};
+
+    if ( not _slotWaiters.empty() or _blockedProducers > 0 or not has_slots( lane, count ))
+        return false;
+
+    acquire_slots( lane, count );
+    return true;
+}
+
+
+// Returns 'false' if slots are acquired without suspension.
+inline bool  TaskSystem::wait_slots (AsyncTask &task, TaskPriority lane, size_t count)
+{
+    std::scoped_lock    lock {_slotGuard};
+
+    // counted before the check, so 'release_slots()' can not miss the waiter
+    _slotWaiting.fetch_add( 1 );
+
+    if ( _slotWaiters.empty() and has_slots( lane, count ))
+    {
+        _slotWaiting.fetch_sub( 1 );
+        acquire_slots( lane, count );
+        return false;  // resume
+    }
+
+    task._waitCount.fetch_add( 1 );
+    _slotWaiters.push_back( SlotWaiter{ RC<AsyncTask>{ &task }, lane, count, std::chrono::steady_clock::now() });
+    return true;  // suspend
+}
+
+
+// Called when task is extracted from the queue, when it is complete and when reservation is not used.
+// Lock is taken only if there are waiting producers.
+inline void  TaskSystem::release_slots (TaskPriority lane, size_t queued, size_t inFlight)
+{
+    const unsigned  i = unsigned(lane);
+
+    if ( queued > 0 )
+        _laneQueued[i].fetch_sub( queued );
+
+    if ( inFlight > 0 )
+        _laneInFlight[i].fetch_sub( inFlight );
+
+    if ( _slotWaiting.load() > 0 )
+        pass_slots();
+}
+
+
+// Pass free slots to waiting producers in FIFO order.
+inline void  TaskSystem::pass_slots ()
+{
+    std::unique_lock    lock {_slotGuard};
+
+    const auto  now = std::chrono::steady_clock::now();
+
+    for (; not _slotWaiters.empty();)
+    {
+        auto&   w = _slotWaiters.front();
+        if ( not has_slots( w.lane, w.count ))
+            break;
+
+        acquire_slots( w.lane, w.count );
+        _statProducerWaitNs.fetch_add( size_t(std::chrono::duration_cast<std::chrono::nanoseconds>( now - w.start ).count()), std::memory_order_relaxed );
+
+        RC<AsyncTask>   t = std::move( w.task );
+        _slotWaiters.pop_front();
+        _slotWaiting.fetch_sub( 1 );
+
+        if ( t->_waitCount.fetch_sub( 1 ) == 1 )
+            t->_system->requeue( std::move(t) );
+    }
+
+    if ( _blockedProducers > 0 )
+    {
+        lock.unlock();
+        _slotCV.notify_all();
+    }
+}
+
+
+inline void  TaskSystem::add_admitted (RC<AsyncTask> task, TaskPriority lane)
+{
+    assert( task->_status.load() == Status::Initial );
+
+    // slots are already acquired
+    task->_inFlightOf   = this;
+    task->_queuedOf     = this;
+    task->_priority     = lane;
+    add( std::move(task) );
+}
+
+
+template <typename T>
+inline void  TaskSystem::add (Task<T> task, Reservation &res)
+{
+    assert( res._ts == this );
+    assert( res._count > 0 );
+
+    --res._count;
+    add_admitted( RC<AsyncTask>{ task.to_async_task() }, res._lane );
+}
+
+
+template <typename T>
+inline bool  TaskSystem::try_add (Task<T> task, TaskPriority lane)
+{
+    if ( not try_acquire_slots( lane, 1 ))
+    {
+        _statRejected.fetch_add( 1, std::memory_order_relaxed );
+        return false;
+    }
+
+    add_admitted( RC<AsyncTask>{ task.to_async_task() }, lane );
+    return true;
+}
+
+
+template <typename T>
+inline void  TaskSystem::add_blocking (Task<T> task, TaskPriority lane)
+{
+    assert( lane < TaskPriority::_Count );
+    assert( _current != this );  // worker can wait for itself, use 'reserve()' in coroutine
+    {
+        std::unique_lock    lock {_slotGuard};
+
+        // counted before the check, so 'release_slots()' can not miss the producer
+        _slotWaiting.fetch_add( 1 );
+
+        if ( not _slotWaiters.empty() or not has_slots( lane, 1 ))
+        {
+            const auto  start = std::chrono::steady_clock::now();
+
+            ++_blockedProducers;
+            _slotCV.wait( lock, [&] () { return _slotWaiters.empty() and has_slots( lane, 1 ); });
+            --_blockedProducers;
+
+            _statProducerWaitNs.fetch_add( size_t(std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count()), std::memory_order_relaxed );
+        }
+        _slotWaiting.fetch_sub( 1 );
+        acquire_slots( lane, 1 );
+    }
+
+    add_admitted( RC<AsyncTask>{ task.to_async_task() }, lane );
+}
+
+
+inline void  AsyncTask::set_completed ()
+{
+    // task which is completed by 'TaskCompletionSource' may not have task system
+    if ( _system != nullptr )
+    {
+        if ( TaskRecorder* rec = _system->recorder() )
+            rec->on_complete( *this, std::chrono::steady_clock::now() );
+    }
+
+    // Recorder is called before the status is changed, because task which is not owned by reference counter,
+    // for example pipeline node, may be reused or destroyed as soon as it is complete.
+    // Few waiters are moved to the stack and '_waiters' keeps its capacity, so reused task does not allocate on each run.
+    std::array< RC<AsyncTask>, 4 >  local;
+    size_t                          localCount  = 0;
+    Waiters_t                       waiters;
+    {
+        std::scoped_lock    lock {_waitersGuard};
+        _status.store( Status::Completed );
+
+        if ( _waiters.size() <= local.size() )
+        {
+            localCount = _waiters.size();
+            std::move( _waiters.begin(), _waiters.end(), local.begin() );
+            _waiters.clear();
+        }
+        else
+            std::swap( waiters, _waiters );
+    }
+
+    // last completed dependency adds the task back to the queue
+    const auto  Resume = [] (RC<AsyncTask> &w)
+    {
+        if ( w->_waitCount.fetch_sub( 1 ) == 1 )
+        {
+            TaskSystem*     dst = w->_system;
+            dst->requeue_continuation( std::move(w) );
+        }
+    };
+    for (size_t i = 0; i < localCount; ++i) {
+        Resume( local[i] );
+    }
+    for (auto& w : waiters) {
+        Resume( w );
+    }
+}
+
+
+inline bool  AsyncTask::has_recorder () const
+{
+    return _system != nullptr and _system->recorder() != nullptr;
+}
+
+
+inline bool  AsyncTask::add_dependency (AsyncTask* dep)
+{
+    assert( dep != nullptr );
+    assert( _status.load() == Status::InProgress );
     {
-        process_tasks(0);
+        std::scoped_lock    lock {dep->_waitersGuard};
+
+        // Edge is recorded under the lock, so the task can not be resumed by the dependency before it is recorded.
+        // Recorder gets 'on_complete()' before the status is changed, so the finish time of complete dependency is known.
+        const bool  complete = dep->is_complete();
+
+        if ( TaskRecorder* rec = _system->recorder() )
+            rec->on_dependency( *this, *dep, complete );
+
+        if ( complete )
+            return false;
+
+        _waitCount.fetch_add( 1 );
+        dep->_waiters.push_back( RC<AsyncTask>{this} );
     }
+
+    // Dependency which is not added to any task system will be scheduled in the system of the current task.
+    Status  expected = Status::Initial;
+    if ( dep->_status.compare_exchange_strong( expected, Status::InQueue ))
+        _system->enqueue( RC<AsyncTask>{dep} );
+
+    return true;
 }
 
 
@@ -483,13 +3947,16 @@ struct TaskAwaiter
     template <typename P>
     bool  await_suspend (std::coroutine_handle<P> curCoro)
     {
-        static_assert( std::is_base_of_v< AsyncTask, P >);
+        static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
 
-        if ( dep.is_complete() )
+        auto&   task = curCoro.promise().task();
+
+        // complete dependency is added only to record the edge
+        if ( dep.is_complete() and not task.has_recorder() )
             return false;  // resume
 
-        curCoro.promise().add_dependency( dep.to_promise() );
-        return true;  // suspend
+        // suspend if dependency is not complete yet
+        return task.add_dependency( dep.to_async_task() );
     }
 };
 
@@ -530,17 +3997,19 @@ struct TaskAwaiter2
     template <typename P>
     bool  await_suspend (std::coroutine_handle<P> curCoro)
     {
-        static_assert( std::is_base_of_v< AsyncTask, P >);
+        static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
 
-        if ( std::apply( [] (auto&& ...args) { return all( args.is_complete() ... ); }, deps ))
-            return false;  // resume
+        auto&   task = curCoro.promise().task();
 
-        std::apply( [p = &curCoro.promise()] (auto&& ...args) {
-                        p->add_dependencies( args.to_promise() ... );
-                    },
-                    deps );
+        // complete dependencies are added only to record the edges
+        if ( not task.has_recorder() and std::apply( [] (auto&& ...args) { return all( args.is_complete() ... ); }, deps ))
+            return false;  // resume
 
-        return true;  // suspend
+        // suspend if any dependency is not complete yet
+        return std::apply(  [p = &task] (auto&& ...args) {
+                                return p->add_dependencies( args.to_async_task() ... );
+                            },
+                            deps );
     }
 };
 
@@ -563,9 +4032,9 @@ struct AsyncTask_Name
         template <typename P>
         bool  await_suspend (std::coroutine_handle<P> curCoro)
         {
-            static_assert( std::is_base_of_v< AsyncTask, P >);
+            static_assert( std::is_base_of_v< AsyncTaskPromise, P >);
 
-            task = &curCoro.promise();
+            task = &curCoro.promise().task();
             return false;  // always resume
         }
     };
@@ -593,6 +4062,45 @@ inline std::string  AsyncTask::name () const
 }
 
 
+inline uint64_t  AsyncTask::sequence_id () const
+{
+    static std::atomic<uint64_t>    counter {0};
+
+    uint64_t    id = _seqId.load( std::memory_order_relaxed );
+    if ( id == 0 )
+    {
+        const uint64_t  next = counter.fetch_add( 1, std::memory_order_relaxed ) + 1;
+
+        // another thread may assign id concurrently
+        if ( _seqId.compare_exchange_strong( id, next, std::memory_order_relaxed ))
+            id = next;
+    }
+    return id;
+}
+
+
+inline std::string  AsyncTask::type_name () const
+{
+    return demangle_name( typeid(*this).name() );
+}
+
+
+inline std::string  demangle_name (const char* name)
+{
+#if defined(__GNUC__) or defined(__clang__)
+    int     status  = 0;
+    char*   str     = abi::__cxa_demangle( name, nullptr, nullptr, &status );
+    if ( str != nullptr )
+    {
+        std::string     result {str};
+        std::free( str );
+        return result;
+    }
+#endif
+    return name;
+}
+
+
 [[nodiscard]] inline size_t  TID ()
 {
     size_t  h = std::hash< std::thread::id >{}( std::this_thread::get_id() );
@@ -10,6 +10,30 @@ extern void  AwaitOverload ();
 extern void  GetCurrentCoro ();
 extern void  DestroyUncompleteCoro ();
 extern void  TaskSystemSample ();
+extern void  FrameArenaSample ();
+extern void  TaskSystemInstances ();
+extern void  BulkSubmission ();
+extern void  ThreadAffinitySample ();
+extern void  CooperativeYield ();
+extern void  DeadlineScheduling ();
+extern void  FrameReclamation ();
+extern void  AutoScheduling ();
+extern void  CompletionSource ();
+extern void  LambdaTasks ();
+extern void  RunUntil ();
+extern void  NextSlot ();
+extern void  StrandSample ();
+extern void  RecurringTasks ();
+extern void  AdmissionControl ();
+extern void  CriticalPath ();
+extern void  FrameProfilerSample ();
+extern void  StaticPipelineSample ();
+extern void  MappedFileSample ();
+extern void  SharedJobQueueSample ();
+extern void  TaskCoarsening ();
+extern void  AwaitProfilerSample ();
+extern void  InlineExecutor ();
+extern void  CostHints ();
 
 // to use '_CrtDumpMemoryLeaks()'
 #ifdef _MSC_VER
@@ -34,6 +58,30 @@ int  main ()
     GetCurrentCoro();       // 7
     DestroyUncompleteCoro();// 8
     TaskSystemSample();     // 9
+    FrameArenaSample();     // 10
+    TaskSystemInstances();  // 11
+    BulkSubmission();       // 12
+    ThreadAffinitySample(); // 13
+    CooperativeYield();     // 14
+    DeadlineScheduling();   // 15
+    FrameReclamation();     // 16
+    AutoScheduling();       // 17
+    CompletionSource();     // 18
+    LambdaTasks();          // 19
+    RunUntil();             // 20
+    NextSlot();             // 21
+    StrandSample();         // 22
+    RecurringTasks();       // 23
+    AdmissionControl();     // 24
+    CriticalPath();         // 25
+    FrameProfilerSample();  // 26
+    StaticPipelineSample(); // 27
+    MappedFileSample();     // 28
+    SharedJobQueueSample(); // 29
+    TaskCoarsening();       // 30
+    AwaitProfilerSample();  // 31
+    InlineExecutor();       // 32
+    CostHints();            // 33
 
     // check for memleaks
     #ifdef _MSC_VER